@@ -0,0 +1,93 @@
+//Anti-aliasing of final image: multisampled color buffer or post-processing
+//of single sample one (FXAA, or TAA with jittered projection)
+#pragma once
+
+#include "ShaderProgram.h"
+#include "common.h"
+#include <glm/glm.hpp>
+#include <string>
+
+enum class AntiAliasingMode {
+    MSAA = 0, //4 samples per pixel, resolved by blit
+    FXAA, //edge blur of tone mapped image
+    TAA //jittered samples accumulated over frames
+};
+
+class AntiAliasing {
+public:
+    AntiAliasing() = default;
+
+    AntiAliasing(const AntiAliasing&) = delete;
+
+    AntiAliasing& operator=(const AntiAliasing& other) = delete;
+
+    //targets of post-processing for width x height image (MSAA needs none)
+    void Setup(std::uint32_t width, std::uint32_t height, AntiAliasingMode mode);
+
+    void Release();
+
+    AntiAliasingMode GetMode() const
+    {
+        return mode;
+    }
+
+    //samples of color buffer for current mode
+    int GetSamples() const
+    {
+        return mode == AntiAliasingMode::MSAA ? 4 : 1;
+    }
+
+    //projection shifted by subpixel offset of this frame with TAA, the same one otherwise,
+    //renderSize is size of viewport scene is rendered to (smaller than target with dynamic resolution)
+    glm::mat4 JitterProjection(const glm::mat4& projection, const glm::ivec2& renderSize);
+
+    //blend color with history reprojected by depth, returns texture with result (TAA only),
+    //viewProjection is jittered one used for rendering, history is reprojected with unjittered,
+    //only uvScale part of textures is rendered (current viewport)
+    GLuint ResolveTemporal(
+        GLuint colorTexture,
+        GLuint depthTexture,
+        const glm::vec2& uvScale,
+        ShaderProgram& program,
+        GLuint quadVAO,
+        const glm::mat4& viewProjection,
+        const glm::mat4& unjitteredViewProjection);
+
+    //forget accumulated frames (e.g. when rendered part of targets changes)
+    void ResetHistory()
+    {
+        hasHistory = false;
+    }
+
+    //framebuffer where tone mapped image is drawn before FXAA (outputFBO without FXAA)
+    GLuint GetFXAATarget(GLuint outputFBO) const
+    {
+        return mode == AntiAliasingMode::FXAA ? ldrFBO : outputFBO;
+    }
+
+    //draw image from FXAA target with smoothed edges to outputFBO
+    void ApplyFXAA(ShaderProgram& program, GLuint quadVAO, GLuint outputFBO);
+
+    static AntiAliasingMode ModeFromString(const std::string& name);
+
+    static std::string ModeToString(AntiAliasingMode mode);
+
+private:
+    AntiAliasingMode mode = AntiAliasingMode::MSAA;
+    std::uint32_t width;
+    std::uint32_t height;
+
+    //FXAA: tone mapped image
+    GLuint ldrFBO = 0;
+    GLuint ldrTexture;
+
+    //TAA: accumulated color of this and previous frames
+    GLuint historyFBO;
+    GLuint historyTextures[2];
+    int current = 0; //history texture written this frame
+    bool hasHistory = false;
+    std::uint32_t frameIndex = 0;
+    glm::mat4 previousViewProjection;
+
+    bool isLoaded = false;
+};
@@ -1,10 +1,22 @@
 //Application class
 #pragma once
 
+#include "AntiAliasing.h"
+#include "BloomChain.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "DynamicResolution.h"
+#include "FrameTimer.h"
+#include "GpuProfiler.h"
+#include "LightClusters.h"
 #include "Models/Material.h"
+#include "Models/MeshBuffer.h"
 #include "Models/Mesh.h"
 #include "Models/Texture.h"
+#include "MomentShadowMap.h"
+#include "RenderQueue.h"
+#include "ShadowAtlas.h"
+#include "ShadowCascades.h"
 
 #include <GLFW/glfw3.h>
 #include <memory>
@@ -28,6 +40,10 @@ public:
     std::vector<bool> keys; //массив состояний кнопок - нажата/не нажата
     bool g_captureMouse = true; //Мышка захвачена нашим приложением или нет?
     bool isFlashlightOn = false; //Is flashlight on?
+    bool switchAntiAliasing = false; //switch to next anti-aliasing mode before next frame
+    bool showRenderStats = false; //print counters of submitted work every second
+    bool toggleRecording = false; //start or stop recording of camera path
+    bool addPathKey = false; //add keyframe with current camera to recorded path
     RenderingMode renderingMode = RenderingMode::DEFAULT;
     Camera camera; //camera
 
@@ -41,7 +57,8 @@ public:
 
 class App {
 public:
-    App(const std::string& pathToConfig);
+    //overrides replace values of config (e.g. from command line)
+    App(const std::string& pathToConfig, const nlohmann::json& overrides = nlohmann::json::object());
 
     App(const App&) = delete;
 
@@ -67,7 +84,13 @@ private:
     std::uint32_t lightIdx = 0;
 
     std::vector<std::vector<std::size_t>> sideSplit; //first - twosided, second - onesided
-    std::unordered_map<std::uint32_t, std::vector<glm::mat4>> duplicatedModels;
+    std::vector<std::size_t> shadowCasters;
+    AABBOX sceneBBOX;
+    StaticMeshBuffer staticMeshBuffer; //shared buffers for static meshes (if enabled in config)
+
+    //draw meshes, static ones from shared buffer with one call
+    //(only meshlets visible from view if it's given)
+    void drawMeshes(const std::vector<std::size_t>& meshIdx, const CullingView* view = nullptr);
 
     nlohmann::json config; //application config
     GLFWwindow* window; //window
@@ -77,43 +100,101 @@ private:
     //color buffer
     //TODO: move this to separate class
     GLuint colorBufferFBO;
-    GLuint colorBufferRBO;
+    GLuint colorBufferRBO; //multisampled depth and stencil
+    GLuint colorBufferDepthTexture; //single sample depth and stencil
     std::vector<GLuint> colorBufferTextures;
-    GLuint pongFBO;
-    GLuint pongRBO;
+    GLuint pongFBO; //resolve of multisampled color
     std::vector<GLuint> pongTextures;
+    GLuint sceneColorTexture; //resolved scene color of the last frame
+    AntiAliasing antiAliasing; //MSAA or post-processing of single sample color buffer
+    BloomChain bloomChain; //blurred bright color, number of levels sets bloom radius
+    FrameTimer frameTimer; //frame rate limit and benchmark statistics
+    GpuProfiler gpuProfiler; //GPU time of render passes
+    std::ofstream renderStatsLog; //counters of RenderStats for every frame
+
+    //camera path is recorded with R and C keys and played back with fixed time step
+    CameraPath cameraPath;
+    bool recordingPath = false;
+    float recordingStart = 0.0f;
+    std::vector<float> playbackCpuTimes; //per played back frame, in milliseconds
+    std::vector<float> playbackGpuTimes; //negative if frame wasn't measured
+    DynamicResolution dynamicResolution; //scene is rendered to part of color buffer sized by GPU frame time
+    glm::ivec2 lastRenderSize = glm::ivec2(0); //TAA history is dropped when render size changes
     void setupColorBuffer();
     void deleteColorBuffer();
-    void renderScene(ShaderProgram& lightningProgram, ShaderProgram& sourceProgram, ShaderProgram& quadColorProgram);
+    void renderScene(
+        ShaderProgram& lightningProgram,
+        ShaderProgram& sourceProgram,
+        ShaderProgram& bloomProgram,
+        ShaderProgram& hiZProgram,
+        ShaderProgram& depthProgram,
+        ShaderProgram& depthAlphaProgram,
+        ShaderProgram& gBufferProgram,
+        ShaderProgram& deferredProgram,
+        ShaderProgram& taaProgram);
+    //light sources and shadow maps for program with lighting.glsl
+    void setupLights(ShaderProgram& program, const glm::mat4& view);
+
+    //G-buffer for deferred shading (single sample):
+    //albedo (RGBA8), normal (RG16), specular (RGBA8), depth
+    GLuint gBufferFBO;
+    std::vector<GLuint> gBufferTextures;
+    void setupGBuffer();
+    void deleteGBuffer();
+
+    //final image goes to outputFBO: default framebuffer or offscreen texture in headless mode
+    GLuint outputFBO = 0;
+    GLuint outputTexture = 0;
+    void setupOutputBuffer();
+    void deleteOutputBuffer();
+    //write final image to directory from config as PNG
+    void dumpFrame(std::uint64_t frame);
+
+    //occlusion culling of meshlets with depth of previous frames
+    HiZBuffer hiZBuffer;
+    CullingStats cullingStats; //camera pass of the last frame
+
+    //camera projection for current window size
+    glm::mat4 getProjection() const;
+
+    //draw items sorted by pass, program, material and mesh
+    RenderQueue renderQueue;
+    void submitRenderQueue(const std::vector<ShaderProgram*>& programs, const CullingView& view);
+    //depth test and color writes for pass
+    void setupRenderPass(RenderPass pass);
 
     //shadow map
     //TODO: move this to separate class
     GLuint shadowMapFBO;
-    GLuint shadowMapRBO;
-    std::vector<GLuint> shadowMapTextures;
+    GLuint shadowMapDepthTexture;
+    MomentShadowMap momentShadowMap; //filtered moments for VSM, EVSM or summed-area table
+    int dirShadowFilter = 0; //0 for PCF, MomentFilter value otherwise
     const uint32_t shadowMapWidth = 2048;
     const uint32_t shadowMapHeight = 2048;
     glm::vec3 lightDir;
     glm::mat4 lightSpaceMatrix;
+    //linear filtering with depth comparison for shadow samplers
+    void setupShadowSampler(GLenum target);
     void setupShadowMapBuffer();
     void deleteShadowMapBuffer();
-    void renderShadowMap(ShaderProgram& depthProgram, ShaderProgram& quadDepthProgram);
+    void renderShadowMap(ShaderProgram& depthProgram, ShaderProgram& momentsProgram);
+    //cascades replace single shadow map if enabled in config
+    ShadowCascades shadowCascades;
 
-    //point shadow map
-    //TODO: move this to separate class
+    //point shadow maps, faces of all lights share one atlas
     //TODO: process transparent objects correctly
-    GLuint pointShadowMapFBO;
-    std::vector<GLuint> pointShadowMapTextures;
-    const uint32_t pointShadowMapWidth = 1024;
-    const uint32_t pointShadowMapHeight = 1024;
+    ShadowAtlas shadowAtlas;
     std::vector<glm::vec3> lightPos;
     std::vector<glm::vec3> lightColors;
-    float nearPlane;
+    glm::vec3 lightAttenuation; //constant, linear and quadratic terms
+    std::vector<float> lightRadii; //lights are skipped beyond this distance
     float farPlane;
-    std::vector<std::vector<glm::mat4>> lightSpaceTransforms;
-    void setupPointShadowMapBuffer();
-    void deletePointShadowMapBuffer();
-    void renderPointShadowMap(ShaderProgram& depthProgram);
+    //point lights without shadows and their assignment to view clusters
+    std::vector<ClusteredLight> extraLights;
+    LightClusters lightClusters;
+    //only faces chosen by atlas are rendered (within budget from config),
+    //shadows are rendered only for lights that reach camera frustum
+    void renderPointShadowMap(ShaderProgram& depthProgram, const Frustum& cameraFrustum);
 
     //simple quad that fills screen
     //TODO: move this to Mesh.cpp
@@ -123,7 +204,7 @@ private:
     void setupQuad();
     void deleteQuad();
     void visualizeShadowMap(ShaderProgram& quadDepthProgram);
-    void visualizeScene(ShaderProgram& quadColorProgram);
+    void visualizeScene(ShaderProgram& quadColorProgram, ShaderProgram& fxaaProgram);
 
     int initGL() const;
 
@@ -142,6 +223,12 @@ private:
     //load geometry
     void loadModels();
 
+    //finish counters of frame, dump image and collect timings of played back frame
+    void finishFrame(std::uint64_t frame, float cpuTime, bool playback);
+
+    //write timings of played back frames as CSV and print their averages
+    void writePlaybackLog();
+
     //main application loop
     void mainLoop();
 
@@ -0,0 +1,45 @@
+//Bloom with mip chain: bright color is progressively downsampled (13 taps)
+//and upsampled back with tent filter, every level adds wider blur
+#pragma once
+
+#include "ShaderProgram.h"
+#include "common.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class BloomChain {
+public:
+    BloomChain() = default;
+
+    BloomChain(const BloomChain&) = delete;
+
+    BloomChain& operator=(const BloomChain& other) = delete;
+
+    //level 0 has half of width x height, more levels give wider bloom
+    void Setup(std::uint32_t width, std::uint32_t height, int numLevels);
+
+    void Release();
+
+    //blur bright color from sourceTexture (full resolution, only uvScale part of it is used),
+    //result is in level 0
+    void Build(GLuint sourceTexture, const glm::vec2& uvScale, ShaderProgram& program, GLuint quadVAO);
+
+    //bind level 0 to texture unit
+    void Bind(int unit) const;
+
+    int GetNumLevels() const
+    {
+        return numLevels;
+    }
+
+private:
+    //read only given level, so it can't form feedback loop with level being rendered
+    void selectLevel(int level);
+
+    int numLevels = 0;
+    std::vector<glm::ivec2> levelSizes;
+    GLuint FBO;
+    GLuint texture; //R11F_G11F_B10F mip chain
+
+    bool isLoaded = false;
+};
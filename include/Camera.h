@@ -57,6 +57,9 @@ public:
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset);
 
+    // sets Euler Angles directly (e.g. from recorded camera path) and updates vectors
+    void SetOrientation(float yaw, float pitch);
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors();
@@ -0,0 +1,47 @@
+//Camera path: keyframes of camera position and orientation, saved to JSON
+//and played back with cubic Hermite spline between them
+#pragma once
+
+#include "Camera.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+struct CameraKey {
+    float time; //in seconds from the beginning of path
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+class CameraPath {
+public:
+    //add keyframe with camera state, times have to increase
+    void AddKey(const Camera& camera, float time);
+
+    void Clear()
+    {
+        keys.clear();
+    }
+
+    std::size_t GetNumKeys() const
+    {
+        return keys.size();
+    }
+
+    //time of the last keyframe
+    float GetDuration() const
+    {
+        return keys.empty() ? 0.0f : keys.back().time;
+    }
+
+    //set position and orientation of camera at time (clamped to path)
+    void Apply(float time, Camera& camera) const;
+
+    void Save(const std::string& path) const;
+
+    void Load(const std::string& path);
+
+private:
+    std::vector<CameraKey> keys;
+};
@@ -0,0 +1,44 @@
+//CPU profiler: scopes marked with PROFILE_SCOPE are recorded to per-thread ring buffers (latest events only)
+//and written as Chrome Trace Event JSON (chrome://tracing, Perfetto),
+//markers are compiled out unless CPU_PROFILER is defined
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class CpuProfiler {
+public:
+#ifdef CPU_PROFILER
+    static const bool enabled = true;
+#else
+    static const bool enabled = false;
+#endif
+
+    //records time between construction and destruction,
+    //name isn't copied, so it has to be string literal
+    class Scope {
+    public:
+        explicit Scope(const char* name);
+
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+
+        Scope& operator=(const Scope& other) = delete;
+
+    private:
+        const char* name;
+        std::int64_t start;
+    };
+
+    //write events of all threads, no thread may record events at the same time
+    static void WriteTrace(const std::string& path);
+};
+
+#ifdef CPU_PROFILER
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) CpuProfiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
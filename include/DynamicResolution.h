@@ -0,0 +1,62 @@
+//Dynamic resolution: scene is rendered to part of render targets,
+//its scale follows GPU frame time measured with timer queries
+#pragma once
+
+#include "common.h"
+#include <glm/glm.hpp>
+
+class DynamicResolution {
+public:
+    DynamicResolution() = default;
+
+    DynamicResolution(const DynamicResolution&) = delete;
+
+    DynamicResolution& operator=(const DynamicResolution& other) = delete;
+
+    //targets have width x height texels, scale stays in [minScale, 1],
+    //targetTime is GPU time of frame in milliseconds
+    void Setup(std::uint32_t width, std::uint32_t height, float minScale, float targetTime);
+
+    void Release();
+
+    //measure GPU time of everything between BeginFrame and EndFrame
+    void BeginFrame();
+
+    void EndFrame();
+
+    //size of rendered part of targets this frame
+    glm::ivec2 GetRenderSize() const;
+
+    //rendered part of targets in texture coordinates
+    glm::vec2 GetUVScale() const;
+
+    float GetScale() const
+    {
+        return scale;
+    }
+
+    //GPU time of the latest measured frame in milliseconds
+    float GetFrameTime() const
+    {
+        return frameTime;
+    }
+
+private:
+    //scale from finished measurements, results are read a few frames late to avoid stalls
+    void update();
+
+    static const int numQueries = 4; //frames in flight
+
+    std::uint32_t width;
+    std::uint32_t height;
+    float minScale;
+    float targetTime;
+    float scale = 1.0f;
+    float frameTime = 0.0f;
+    GLuint queries[numQueries];
+    bool pending[numQueries] = {};
+    int nextQuery = 0;
+    int framesSinceChange = 0;
+
+    bool isLoaded = false;
+};
@@ -0,0 +1,42 @@
+//Frame pacing and benchmark statistics: frames can be limited to target rate
+//by sleeping after swap, benchmark run stops after given number of frames
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class FrameTimer {
+public:
+    FrameTimer() = default;
+
+    FrameTimer(const FrameTimer&) = delete;
+
+    FrameTimer& operator=(const FrameTimer& other) = delete;
+
+    //targetFPS 0 doesn't limit frame rate, benchmarkFrames 0 runs until window is closed
+    void Setup(float targetFPS, std::uint32_t benchmarkFrames);
+
+    //start of frame, measures time since start of previous one
+    void BeginFrame();
+
+    //end of frame (after swap), sleeps until start of next frame if rate is limited
+    void EndFrame();
+
+    //all benchmark frames are measured
+    bool IsFinished() const;
+
+    //min/avg/p95/p99/max of measured frame times
+    void PrintStats(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration period = Clock::duration::zero(); //zero if rate isn't limited
+    Clock::time_point frameStart;
+    Clock::time_point nextFrame; //deadline of paced frame
+    std::uint32_t benchmarkFrames = 0;
+    std::uint32_t numFrames = 0;
+    std::vector<float> frameTimes; //in milliseconds, warm-up frames are skipped
+};
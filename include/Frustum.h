@@ -0,0 +1,18 @@
+//View frustum for culling of bounding volumes
+#pragma once
+
+#include <glm/glm.hpp>
+
+class Frustum {
+public:
+    Frustum() = default;
+
+    //extract planes from projection * view matrix (OpenGL clip space)
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    //true if sphere is at least partially inside frustum
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+
+private:
+    glm::vec4 planes[6]; //normalized, normals point inside
+};
@@ -0,0 +1,78 @@
+//GPU profiler: named zones are measured with timestamp queries, queries of a few
+//frames are in flight, so results are read without waiting for GPU
+#pragma once
+
+#include "common.h"
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class GpuProfiler {
+public:
+    GpuProfiler() = default;
+
+    GpuProfiler(const GpuProfiler&) = delete;
+
+    GpuProfiler& operator=(const GpuProfiler& other) = delete;
+
+    //at most maxZones zones per frame, times of every frame are written to logPath
+    //as CSV (frame,zone,ms) if it isn't empty
+    void Setup(std::size_t maxZones, const std::string& logPath);
+
+    void Release();
+
+    //read results of the oldest frame if GPU has finished it, then start recording
+    //(frame isn't recorded if all frames are still in flight)
+    void BeginFrame();
+
+    void EndFrame();
+
+    //wait for frames in flight and read their results
+    void Flush();
+
+    //zones can be nested, zones with the same path in one frame are summed,
+    //path of nested zone is "parent/name"
+    void BeginZone(const std::string& name);
+
+    void EndZone();
+
+    //rolling averages of zones in milliseconds, e.g. "scene 3.10 scene/bloom 0.25"
+    std::string GetSummary() const;
+
+    //index and time (first to last timestamp) of frames read since last call
+    std::vector<std::pair<std::uint64_t, float>> TakeFrameTimes();
+
+private:
+    static const int numFrames = 4;
+
+    struct Zone {
+        std::string path;
+        std::size_t begin; //indices of timestamp queries
+        std::size_t end;
+    };
+
+    struct Frame {
+        std::vector<GLuint> queries;
+        std::vector<Zone> zones;
+        std::size_t numUsed = 0;
+        std::uint64_t index = 0;
+        bool pending = false;
+    };
+
+    //read timestamps of frame, update averages and log
+    void collect(Frame& frame);
+
+    std::size_t maxZones;
+    Frame frames[numFrames];
+    int current = 0;
+    bool recording = false;
+    std::uint64_t frameIndex = 0;
+    std::vector<std::size_t> openZones; //stack of zones without end
+    std::vector<std::string> paths; //zones in order of first appearance
+    std::vector<float> averages; //of zones in paths
+    std::vector<std::pair<std::uint64_t, float>> frameTimes;
+    std::ofstream log;
+
+    bool isLoaded = false;
+};
@@ -0,0 +1,64 @@
+//Hierarchical depth buffer for occlusion culling with previous frame depth
+#pragma once
+
+#include "ShaderProgram.h"
+#include "common.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class HiZBuffer {
+public:
+    HiZBuffer() = default;
+
+    HiZBuffer(const HiZBuffer&) = delete;
+
+    HiZBuffer& operator=(const HiZBuffer& other) = delete;
+
+    void Setup(std::uint32_t width, std::uint32_t height);
+
+    void Release();
+
+    //build max depth pyramid from depth of sourceFBO (rendered with viewProjection to sourceSize texels
+    //in its corner, it's copied 1:1 and stretched to the whole pyramid by copy pass) and start asynchronous readback of its low resolution level
+    void Build(GLuint sourceFBO, const glm::ivec2& sourceSize, ShaderProgram& program, GLuint quadVAO, const glm::mat4& viewProjection);
+
+    //take finished readback (if any) for CPU tests, never waits for GPU
+    void Update();
+
+    //true if there is depth to test against
+    bool IsReady() const
+    {
+        return hasDepth;
+    }
+
+    //true if sphere is behind depth of frame read back last
+    bool IsOccluded(const glm::vec3& center, float radius) const;
+
+private:
+    //readback of one frame
+    struct Readback {
+        GLuint PBO;
+        GLsync fence = nullptr;
+        glm::mat4 viewProjection;
+    };
+
+    static const int numReadbacks = 3; //frames in flight
+
+    std::uint32_t width;
+    std::uint32_t height;
+    int numLevels;
+    int readbackLevel; //level of pyramid read back to CPU (1/8 of screen resolution)
+    GLuint copyFBO; //depth is blitted here
+    GLuint pyramidFBO; //levels of pyramid are rendered here
+    GLuint depthTexture; //single sample copy of depth buffer
+    GLuint hiZTexture; //max depth pyramid
+    Readback readbacks[numReadbacks];
+    int nextReadback = 0;
+
+    //CPU pyramid built from read back level, level i has size of GPU level readbackLevel + i
+    std::vector<std::vector<float>> levels;
+    std::vector<glm::ivec2> levelSizes;
+    glm::mat4 viewProjection; //matrix of depth in levels
+    bool hasDepth = false;
+    bool isLoaded = false;
+};
@@ -0,0 +1,102 @@
+//Clustered light assignment: view frustum is split into 3D grid of clusters
+//and every cluster gets list of lights whose spheres touch it
+#pragma once
+
+#include "ShaderProgram.h"
+#include "common.h"
+#include <condition_variable>
+#include <functional>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//point light with limited range
+struct ClusteredLight {
+    glm::vec3 position; //in World space
+    glm::vec3 color;
+    float quadratic = 0.0f; //attenuation 1 / (1 + quadratic * dist^2)
+    float radius = 0.0f; //no light beyond this distance
+};
+
+class LightClusters {
+public:
+    //clusters along x, y (screen tiles) and z (exponential depth slices)
+    static const int dimX = 16;
+    static const int dimY = 9;
+    static const int dimZ = 24;
+    static const int numClusters = dimX * dimY * dimZ;
+    //shadowed lights are marked in cluster with bit mask instead of list
+    static const int maxShadowedLights = 16;
+
+    LightClusters() = default;
+
+    //only stops worker threads, GL objects have to be freed with Release
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+
+    LightClusters& operator=(const LightClusters& other) = delete;
+
+    //also starts worker threads that build light lists every update
+    void Setup(std::size_t maxLights);
+
+    void Release();
+
+    //build light lists for frustum of symmetric perspective projection
+    //(lists are built by worker threads and calling one, each one takes its own depth slices)
+    void Update(
+        const glm::mat4& view,
+        float fovY,
+        float aspect,
+        float near,
+        float far,
+        const std::vector<ClusteredLight>& lights,
+        const std::vector<ClusteredLight>& shadowedLights);
+
+    //bind lights and lists to texture units and set uniforms used by lighting.glsl
+    void Bind(ShaderProgram& program, int lightsUnit, int gridUnit) const;
+
+    //distance at which light of given intensity is attenuated below threshold,
+    //attenuation is 1 / (constant + linear * dist + quadratic * dist^2)
+    static float EffectiveRadius(float intensity, float constant, float linear, float quadratic, float threshold);
+
+    //total length of light lists in last update
+    std::size_t GetNumAssigned() const
+    {
+        return numAssigned;
+    }
+
+private:
+    //run job(thread index) on every worker and calling thread, return when all are done
+    void runOnWorkers(const std::function<void(int)>& job);
+
+    void workerLoop(int index, std::uint64_t generation);
+
+    void stopWorkerThreads();
+
+    std::size_t maxLights = 0;
+    std::size_t maxTexels = 0; //limit of texture buffer size
+    std::size_t numAssigned = 0;
+    glm::vec2 depthParams; //slice = log(depth) * x + y
+
+    //2 texels per light: position in View space and radius, color and quadratic attenuation
+    GLuint lightsTBO;
+    GLuint lightsTexture;
+    //2 texels per cluster: offset of list and count | shadowed lights mask << 16,
+    //then lists of light indices
+    GLuint gridTBO;
+    GLuint gridTexture;
+
+    //persistent workers, so threads aren't created every frame
+    std::vector<std::thread> workers;
+    std::mutex workersMutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    const std::function<void(int)>* job = nullptr;
+    std::uint64_t jobGeneration = 0;
+    int pendingWorkers = 0;
+    bool stopWorkers = false;
+
+    bool isLoaded = false;
+};
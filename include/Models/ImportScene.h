@@ -14,6 +14,9 @@ void importSceneFromFile(
     std::unordered_map<uint32_t, Material>& materials,
     std::unordered_map<std::string, std::unique_ptr<Texture>>& textures);
 
+//merge static meshes with the same material
+//if splitForShortIndices is set, merged meshes are split into parts addressable with 16-bit indices
 std::vector<std::shared_ptr<Mesh>> unifyStaticMeshes(
     std::vector<std::shared_ptr<Mesh>>& scene,
-    const std::unordered_map<uint32_t, Material>& materials);
\ No newline at end of file
+    const std::unordered_map<uint32_t, Material>& materials,
+    bool splitForShortIndices = false);
\ No newline at end of file
@@ -38,6 +38,13 @@ public:
         int specularIdx,
         int normalIdx);
 
+    //only uniforms needed to discard alpha tested fragments (depth pre-pass)
+    void SetupAlphaTest(
+        ShaderProgram& program,
+        std::unordered_map<std::string, std::unique_ptr<Texture>>& textures,
+        const GLenum diffuseTextureId,
+        int diffuseIdx);
+
     void SetMaps(
         const std::string& diffuseMapPath_,
         const std::string& specularMapPath_,
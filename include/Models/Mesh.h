@@ -19,6 +19,30 @@ struct AABBOX {
     }
 };
 
+//cluster of triangles in index buffer with bounds for culling
+struct Meshlet {
+    std::uint32_t firstIndex;
+    std::uint32_t count; //number of indices
+    glm::vec3 center; //bounding sphere
+    float radius;
+    glm::vec3 coneAxis; //average normal
+    float coneCutoff; //sine of normal cone half-angle, 1 if cone can't be used for culling
+
+    //true if all triangles face away from viewPos
+    bool IsBackfacing(const glm::vec3& viewPos) const
+    {
+        glm::vec3 toCenter = center - viewPos;
+        float distance = glm::length(toCenter);
+        return glm::dot(toCenter, coneAxis) >= coneCutoff * distance + radius;
+    }
+};
+
+//per-instance data stored in instance buffer
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normalMatrix; //transpose(inverse(model)), view rotation is applied in shader
+};
+
 struct Mesh {
 public:
     std::vector<glm::vec3> positions;
@@ -33,6 +57,10 @@ public:
     std::vector<glm::vec3> bitangents;
     std::string name;
     bool isEmpty;
+    std::vector<glm::mat4> instanceModels; //model matrices of all drawn copies, {model} if empty
+    bool quantizePositions = false; //store positions as unorm16 relative to bounding box on GPU
+    glm::mat4 positionDequantization = glm::mat4(1.0f); //restores positions from quantized ones
+    std::vector<Meshlet> meshlets; //consecutive ranges of indices, empty if mesh isn't split
 
     Mesh()
         : isEmpty(true)
@@ -93,11 +121,22 @@ public:
         return indices.size() / 3;
     }
 
+    std::uint32_t numberOfInstances() const
+    {
+        return instanceModels.empty() ? 1 : instanceModels.size();
+    }
+
     void GLLoad();
     void GLUpdatePositionsNormals();
 
+    //set model matrices of instances (uploaded to GPU once, not on every draw)
+    void SetInstances(const std::vector<glm::mat4>& modelMatrices);
+
+    //model (with position dequantization) and normal matrices of all instances as stored in instance buffer
+    std::vector<InstanceData> GetInstanceData() const;
+
+    //draw all instances
     void Draw() const;
-    void Draw(const std::vector<glm::mat4>& modelMatrices) const;
 
     void Release();
 
@@ -109,15 +148,18 @@ public:
     AABBOX GetAABBOX(const bool inWorldSpace = true) const;
 
 private:
+    void GLLoadInstances();
+
     bool isLoaded = false;
-    GLuint positionsVBO;
-    GLuint normalsVBO;
-    GLuint texCoordsVBO;
+    GLenum indexType = GL_UNSIGNED_INT; //type of indices in EBO
+    GLuint VBO; //interleaved packed vertices
     GLuint modelsVBO;
-    GLuint tangentsVBO;
-    GLuint bitangentsVBO;
     GLuint VAO;
     GLuint EBO;
 };
 
+//setup per-instance attributes (locations 5-11) for instance buffer bound to GL_ARRAY_BUFFER
+//offset - byte offset of the first instance in the buffer
+void setupInstanceAttributes(GLintptr offset = 0);
+
 std::unique_ptr<Mesh> createCube();
\ No newline at end of file
@@ -0,0 +1,87 @@
+//Shared vertex/index buffer for static meshes with multi-draw submission
+#pragma once
+
+#include "Frustum.h"
+#include "HiZBuffer.h"
+#include "Models/Mesh.h"
+#include "common.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+//command layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+//number of meshlets drawn and rejected by every test
+struct CullingStats {
+    std::uint32_t visible = 0;
+    std::uint32_t frustumCulled = 0;
+    std::uint32_t backfaceCulled = 0;
+    std::uint32_t occlusionCulled = 0;
+};
+
+//view used to cull meshlets of meshes in buffer
+struct CullingView {
+    Frustum frustum;
+    glm::vec3 position; //viewer position for normal cone culling
+    bool cullBackfacing = false; //reject meshlets facing away from viewer (only for one-sided meshes)
+    const HiZBuffer* occlusion = nullptr; //depth of previous frames to test against
+    CullingStats* stats = nullptr; //incremented if set
+};
+
+class StaticMeshBuffer {
+public:
+    StaticMeshBuffer() = default;
+
+    StaticMeshBuffer(const StaticMeshBuffer&) = delete;
+
+    StaticMeshBuffer& operator=(const StaticMeshBuffer& other) = delete;
+
+    //pack meshes with given indices into one vertex, one index and one instance buffer
+    //(vertices use packed format, positions are quantized relative to bounding box of every mesh if requested)
+    void GLLoad(
+        const std::vector<std::shared_ptr<Mesh>>& scene,
+        const std::vector<std::size_t>& meshIdx,
+        bool quantizePositions);
+
+    //draw given meshes with one glMultiDrawElementsIndirect call
+    //(or with a loop of glDrawElementsInstancedBaseVertex if indirect drawing isn't supported)
+    //if view is given, only visible meshlets are drawn (consecutive ones with one command)
+    void Draw(const std::vector<std::size_t>& meshIdx, const CullingView* view = nullptr);
+
+    void Release();
+
+    bool Contains(std::size_t meshIdx) const
+    {
+        return meshes.count(meshIdx) > 0;
+    }
+
+    bool IsLoaded() const
+    {
+        return isLoaded;
+    }
+
+private:
+    struct BufferedMesh {
+        DrawElementsIndirectCommand range; //part of buffers with mesh
+        std::vector<Meshlet> meshlets; //in world space, empty if mesh has no meshlets or several instances
+    };
+
+    std::unordered_map<std::size_t, BufferedMesh> meshes; //mesh index -> its part of buffers
+    std::vector<DrawElementsIndirectCommand> commands; //reused between draws
+    bool isLoaded = false;
+    bool useIndirect = false;
+    bool quantizedPositions = false;
+    GLenum indexType = GL_UNSIGNED_INT; //16-bit if all meshes have few enough vertices
+    GLuint VAO;
+    GLuint VBO;
+    GLuint EBO;
+    GLuint instancesVBO;
+    GLuint indirectBuffer;
+};
@@ -0,0 +1,63 @@
+//Index and vertex buffer optimizations for post-transform vertex cache, overdraw and vertex fetch
+#pragma once
+
+#include "Models/Mesh.h"
+#include <cstdint>
+#include <vector>
+
+struct OptimizationStats {
+    std::uint64_t numFaces = 0;
+    std::uint64_t missesBefore = 0; //transformed vertices with simulated FIFO cache before optimization
+    std::uint64_t missesAfter = 0;
+
+    //average cache miss ratio (transformed vertices per triangle)
+    float ACMRBefore() const
+    {
+        return numFaces ? static_cast<float>(missesBefore) / numFaces : 0.0f;
+    }
+
+    float ACMRAfter() const
+    {
+        return numFaces ? static_cast<float>(missesAfter) / numFaces : 0.0f;
+    }
+
+    void Add(const OptimizationStats& other)
+    {
+        numFaces += other.numFaces;
+        missesBefore += other.missesBefore;
+        missesAfter += other.missesAfter;
+    }
+};
+
+//number of cache misses for FIFO cache of given size
+std::uint64_t simulateVertexCache(
+    const std::vector<std::uint32_t>& indices,
+    std::uint32_t numVertices,
+    std::uint32_t cacheSize = 16);
+
+//reorder triangles for post-transform vertex cache (Forsyth's algorithm)
+//only triangles in [firstIndex, firstIndex + count) are reordered
+void optimizeVertexCache(
+    std::vector<std::uint32_t>& indices,
+    std::uint32_t numVertices,
+    std::size_t firstIndex,
+    std::size_t count);
+
+//split cache optimized triangles into clusters at cache flushes
+//and sort them so that clusters facing outwards of the mesh are drawn first
+void optimizeOverdraw(
+    std::vector<std::uint32_t>& indices,
+    const std::vector<glm::vec3>& positions,
+    std::size_t firstIndex,
+    std::size_t count);
+
+//reorder vertices in order of first use in index buffer
+void optimizeVertexFetch(Mesh& mesh);
+
+//reorder triangles into spatially coherent meshlets of at most maxFaces triangles
+//(by Morton code of triangle centers), optimize them for vertex cache,
+//sort them for overdraw and compute their bounds, returns stats of the final order
+OptimizationStats buildMeshlets(Mesh& mesh, std::uint32_t maxFaces);
+
+//run all optimizations above for mesh (except building meshlets)
+OptimizationStats optimizeMesh(Mesh& mesh);
@@ -0,0 +1,40 @@
+//Packed interleaved vertex format
+//position: 3 x float or 4 x unorm16 (quantized relative to mesh bounding box, w unused)
+//normal: 2 x snorm16 (octahedral encoding)
+//tangent: 4 x snorm16 (octahedral encoding, bitangent sign, unused)
+//texture coordinates: 2 x half float
+//indices: unsigned short if mesh has few enough vertices, unsigned int otherwise
+#pragma once
+
+#include "Models/Mesh.h"
+#include "common.h"
+#include <cstdint>
+#include <vector>
+
+//size of one packed vertex in bytes (28 or 24 with quantized positions instead of 56)
+std::size_t packedVertexSize(bool quantizedPositions);
+
+//append packed vertices of mesh to data
+//returns matrix which transforms quantized positions back to mesh positions (identity if not quantized)
+glm::mat4 packVertices(
+    const Mesh& mesh,
+    bool quantizePositions,
+    std::vector<std::uint8_t>& data);
+
+//setup attributes (locations 0-3) for packed vertices in buffer bound to GL_ARRAY_BUFFER
+void setupPackedVertexAttributes(bool quantizedPositions);
+
+//max number of vertices addressable with 16-bit indices
+const std::uint32_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+//smallest index type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) for mesh with given number of vertices
+GLenum indexTypeFor(std::uint32_t numVertices);
+
+//size of one index of given type in bytes
+std::size_t indexSize(GLenum indexType);
+
+//append indices converted to given type to data
+void packIndices(
+    const std::vector<std::uint32_t>& indices,
+    GLenum indexType,
+    std::vector<std::uint8_t>& data);
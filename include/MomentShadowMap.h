@@ -0,0 +1,54 @@
+//Filtered moments of directional shadow map (variance shadow maps and their variants),
+//moments are built from depth at half resolution, so shadow pass writes depth only
+#pragma once
+
+#include "ShaderProgram.h"
+#include "common.h"
+#include <glm/glm.hpp>
+#include <string>
+
+enum class MomentFilter {
+    VSM = 1, //depth and depth^2, blurred and mipmapped
+    EVSM = 2, //positive and negative exponential warp of depth, blurred and mipmapped
+    SAT = 3 //summed-area table of depth and depth^2, box filter of any width in shader
+};
+
+class MomentShadowMap {
+public:
+    MomentShadowMap() = default;
+
+    MomentShadowMap(const MomentShadowMap&) = delete;
+
+    MomentShadowMap& operator=(const MomentShadowMap& other) = delete;
+
+    //moments of depth map with depthWidth x depthHeight texels,
+    //bits (16 or 32) is precision of VSM and EVSM, SAT always needs 32
+    void Setup(std::uint32_t depthWidth, std::uint32_t depthHeight, MomentFilter filter, int bits);
+
+    void Release();
+
+    //moments of 2x2 texels of depthTexture, then blur and mipmaps (or summed-area table)
+    void Build(GLuint depthTexture, ShaderProgram& program, GLuint quadVAO);
+
+    //bind filtered moments to texture unit and set uniforms used by lighting.glsl
+    void Bind(ShaderProgram& program, int unit) const;
+
+    //"vsm", "evsm" or "sat"
+    static MomentFilter FilterFromString(const std::string& name);
+
+private:
+    void drawPass(ShaderProgram& program, GLuint source, GLuint target);
+
+    MomentFilter filter = MomentFilter::VSM;
+    int bits = 16;
+    std::uint32_t width;
+    std::uint32_t height;
+    int numLevels;
+    glm::vec2 evsmExponents = glm::vec2(0.0f); //positive and negative, limited by range of texture format
+    float minVariance = 0.0f; //against precision loss of moments
+    GLuint FBO;
+    GLuint textures[2]; //ping-pong, filtered moments end up in textures[result]
+    int result = 0;
+
+    bool isLoaded = false;
+};
@@ -0,0 +1,81 @@
+//Queue of draw items sorted by 64-bit keys to minimize state changes
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum RenderPass {
+    DEPTH_PREPASS = 0, //depth only, lighting pass then shades only visible fragments
+    GBUFFER_PASS, //surface attributes for deferred lighting
+    LIGHTING_PASS,
+    LIGHT_SOURCES_PASS
+};
+
+enum CullMode {
+    CULL_NONE = 0, //twosided objects, drawn first
+    CULL_BACK
+};
+
+//slots of shader programs passed to App::submitRenderQueue
+enum RenderProgram {
+    LIGHTING_PROGRAM = 0, //forward shading
+    SOURCE_PROGRAM, //light source cubes
+    DEPTH_PROGRAM, //opaque depth pre-pass, no material
+    DEPTH_ALPHA_PROGRAM, //alpha tested depth pre-pass
+    GBUFFER_PROGRAM,
+    NUM_PROGRAMS
+};
+
+//key layout (from most to least significant bits):
+//pass (4) | cull mode (1) | program (8) | material (16) | unused (3) | mesh (32)
+struct RenderKey {
+    static std::uint64_t Make(
+        RenderPass pass,
+        CullMode cullMode,
+        std::uint32_t program,
+        std::uint32_t material,
+        std::uint32_t mesh)
+    {
+        return (static_cast<std::uint64_t>(pass & 0xF) << 60)
+            | (static_cast<std::uint64_t>(cullMode & 0x1) << 59)
+            | (static_cast<std::uint64_t>(program & 0xFF) << 51)
+            | (static_cast<std::uint64_t>(material & 0xFFFF) << 35)
+            | static_cast<std::uint64_t>(mesh);
+    }
+
+    static RenderPass GetPass(std::uint64_t key) { return static_cast<RenderPass>((key >> 60) & 0xF); }
+    static CullMode GetCullMode(std::uint64_t key) { return static_cast<CullMode>((key >> 59) & 0x1); }
+    static std::uint32_t GetProgram(std::uint64_t key) { return (key >> 51) & 0xFF; }
+    static std::uint32_t GetMaterial(std::uint64_t key) { return (key >> 35) & 0xFFFF; }
+    static std::uint32_t GetMesh(std::uint64_t key) { return key & 0xFFFFFFFF; }
+};
+
+class RenderQueue {
+public:
+    void Clear()
+    {
+        keys.clear();
+    }
+
+    void Push(
+        RenderPass pass,
+        CullMode cullMode,
+        std::uint32_t program,
+        std::uint32_t material,
+        std::uint32_t mesh)
+    {
+        keys.push_back(RenderKey::Make(pass, cullMode, program, material, mesh));
+    }
+
+    //LSD radix sort of keys (8 bits per pass)
+    void Sort();
+
+    const std::vector<std::uint64_t>& GetKeys() const
+    {
+        return keys;
+    }
+
+private:
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint64_t> scratch;
+};
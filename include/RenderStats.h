@@ -0,0 +1,49 @@
+//Per-frame counters of submitted work: GL entry points loaded by glad are replaced
+//with ones that count calls per pass before calling the driver
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct PassStats {
+    std::uint64_t drawCalls = 0;
+    std::uint64_t triangles = 0;
+    std::uint64_t instances = 0;
+    std::uint64_t programBinds = 0;
+    std::uint64_t textureBinds = 0;
+    std::uint64_t uniformUploads = 0;
+    std::uint64_t bytesUploaded = 0; //with glBufferData and glBufferSubData
+    std::uint64_t framebufferBinds = 0;
+
+    PassStats& operator+=(const PassStats& other);
+};
+
+class RenderStats {
+public:
+    //replace counted GL functions, has to be called after glad loaded them
+    static void Install();
+
+    //counters of following calls go to pass with this name
+    static void SetPass(const std::string& name);
+
+    //multi-draw indirect reads commands from GPU buffer, so caller reports what they draw
+    static void AddIndirectDraw(std::uint64_t triangles, std::uint64_t instances);
+
+    //passes of this frame become stats of last frame, counters start from zero
+    static void EndFrame();
+
+    //passes of last frame in order of first use
+    static const std::vector<std::pair<std::string, PassStats>>& GetLastFrame();
+
+    static PassStats GetLastFrameTotal();
+
+    //table of passes of last frame
+    static void Print(std::ostream& out);
+
+    //CSV rows (frame,pass,counters...) of last frame, header is written with frame 0
+    static void WriteCSV(std::ostream& out, std::uint64_t frame);
+};
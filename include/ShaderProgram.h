@@ -33,6 +33,8 @@ public:
 
     void SetUniform(const std::string& location, unsigned int value) const;
 
+    void SetUniform(const std::string& location, const glm::vec2& value) const;
+
     void SetUniform(const std::string& location, const glm::vec3& value) const;
 
     void SetUniform(const std::string& location, const glm::vec4 &value) const;
@@ -0,0 +1,91 @@
+//Shadow atlas for point lights: faces of every light cube are tiles of one depth texture,
+//tile size depends on light size on screen and only a few faces are rendered every frame
+#pragma once
+
+#include "Frustum.h"
+#include "ShaderProgram.h"
+#include "common.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+//face of point light cube
+struct ShadowFace {
+    std::uint32_t light;
+    std::uint32_t face; //+X, -X, +Y, -Y, +Z, -Z
+};
+
+class ShadowAtlas {
+public:
+    ShadowAtlas() = default;
+
+    ShadowAtlas(const ShadowAtlas&) = delete;
+
+    ShadowAtlas& operator=(const ShadowAtlas& other) = delete;
+
+    //atlas is 3/2 * size x size texels, so 3x2 blocks of faces fill it without gaps
+    void Setup(
+        std::uint32_t size,
+        std::uint32_t numLights,
+        std::uint32_t minResolution,
+        std::uint32_t maxResolution);
+
+    void Release();
+
+    //choose face resolution of every light from its size on screen, repack atlas if it changed,
+    //then return at most budget faces to render: faces without valid shadow first,
+    //then faces that see dynamic casters (spheres), then the rest of visible lights round robin
+    std::vector<ShadowFace> Update(
+        const std::vector<glm::vec3>& positions,
+        const std::vector<float>& radii,
+        const Frustum& cameraFrustum,
+        const glm::vec3& cameraPosition,
+        float fovY,
+        std::uint32_t screenHeight,
+        const std::vector<glm::vec4>& dynamicCasters,
+        std::uint32_t budget);
+
+    //projection and view of face (same basis as in lighting.glsl)
+    glm::mat4 GetFaceMatrix(const ShadowFace& face) const;
+
+    //bind framebuffer with viewport and scissor set to tile of face and clear its depth
+    void BeginFace(const ShadowFace& face);
+
+    //restore scissor test after faces are rendered
+    void End();
+
+    //bind atlas to texture unit and set tiles of lights used by lighting.glsl
+    void Bind(ShaderProgram& program, int unit) const;
+
+    //faces rendered in last update
+    std::uint32_t GetNumRendered() const
+    {
+        return numRendered;
+    }
+
+private:
+    struct LightTiles {
+        std::uint32_t requested = 0; //face resolution chosen from screen size
+        std::uint32_t resolution = 0; //of one face, 0 if light didn't fit into atlas
+        glm::uvec2 offset; //of 3x2 block in texels
+        std::uint32_t validFaces = 0; //bit mask of faces rendered since last repack
+    };
+
+    //place 3x2 blocks on shelves, lights that don't fit get smaller faces,
+    //returns false if some light didn't fit even with the smallest faces
+    bool pack(const std::vector<std::uint32_t>& resolutions, std::vector<LightTiles>& result) const;
+
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t minResolution;
+    std::uint32_t maxResolution;
+    GLuint FBO;
+    GLuint depthTexture;
+
+    std::vector<LightTiles> tiles;
+    std::vector<glm::vec3> positions;
+    std::vector<float> radii;
+    std::uint32_t roundRobin = 0; //next face of round robin updates
+    std::uint32_t numRendered = 0;
+
+    bool isLoaded = false;
+};
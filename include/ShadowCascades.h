@@ -0,0 +1,73 @@
+//Cascaded shadow maps of directional light fitted to slices of camera frustum
+#pragma once
+
+#include "ShaderProgram.h"
+#include "common.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class ShadowCascades {
+public:
+    static const int maxCascades = 4;
+
+    ShadowCascades() = default;
+
+    ShadowCascades(const ShadowCascades&) = delete;
+
+    ShadowCascades& operator=(const ShadowCascades& other) = delete;
+
+    //numCascades layers of depth texture array with resolution x resolution texels
+    void Setup(int numCascades, std::uint32_t resolution);
+
+    void Release();
+
+    //fit cascades to slices of camera frustum (symmetric perspective projection),
+    //light view volume is extended to the scene bounding box to include all casters,
+    //returns cascades that have to be rendered this frame (far ones are updated less often)
+    std::vector<int> Update(
+        const glm::mat4& view,
+        float fovY,
+        float aspect,
+        float near,
+        float shadowDistance,
+        const glm::vec3& lightDir,
+        const glm::vec3& sceneMin,
+        const glm::vec3& sceneMax);
+
+    //bind framebuffer with layer of cascade, set viewport and clear depth
+    void BeginCascade(int cascade);
+
+    //light space matrix of cascade
+    const glm::mat4& GetMatrix(int cascade) const
+    {
+        return matrices[cascade];
+    }
+
+    int GetNumCascades() const
+    {
+        return numCascades;
+    }
+
+    //depth texture array, sampled with comparison
+    GLuint GetDepthTexture() const
+    {
+        return depthTexture;
+    }
+
+    //bind depth texture array to texture unit and set uniforms used by lighting.glsl
+    //(with no cascades lighting falls back to single shadow map)
+    void Bind(ShaderProgram& program, int unit) const;
+
+private:
+    int numCascades = 0;
+    std::uint32_t resolution;
+    GLuint FBO;
+    GLuint depthTexture; //array with layer per cascade
+    std::uint64_t frameIndex = 0;
+
+    std::vector<float> splits; //far distance of every cascade in View space
+    std::vector<glm::mat4> matrices; //matrices of last rendered cascades
+    std::vector<float> biases; //depth bias of about one texel
+
+    bool isLoaded = false;
+};
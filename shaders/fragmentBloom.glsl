@@ -0,0 +1,80 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT
+{
+    vec2 texCoords;
+}
+fsIn;
+
+uniform sampler2D sourceBuffer; //bright color or level of bloom chain (only one level is accessible)
+uniform bool upsample; //tent filter of smaller level instead of 13-tap downsample
+uniform bool firstLevel; //downsample of full resolution color
+uniform vec2 uvScale; //rendered part of full resolution color (dynamic resolution)
+
+float luminanceWeight(vec3 color)
+{
+    return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+//average of four taps, weighted by luminance on the first level (Karis average)
+vec3 average(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    if (!firstLevel) {
+        return 0.25 * (a + b + c + d);
+    }
+    vec4 sum = vec4(a, 1.0) * luminanceWeight(a)
+        + vec4(b, 1.0) * luminanceWeight(b)
+        + vec4(c, 1.0) * luminanceWeight(c)
+        + vec4(d, 1.0) * luminanceWeight(d);
+    return sum.rgb / sum.a;
+}
+
+vec3 tap(vec2 offset)
+{
+    if (firstLevel) {
+        //rendered part is stretched over the whole chain, taps don't leave it
+        vec2 halfTexel = 0.5 / vec2(textureSize(sourceBuffer, 0));
+        return texture(sourceBuffer, clamp(fsIn.texCoords * uvScale + offset, halfTexel, uvScale - halfTexel)).rgb;
+    }
+    return texture(sourceBuffer, fsIn.texCoords + offset).rgb;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(sourceBuffer, 0));
+    if (upsample) {
+        //3x3 tent, 1 2 1 / 2 4 2 / 1 2 1
+        vec3 color = 4.0 * tap(vec2(0.0));
+        color += 2.0 * (tap(vec2(texel.x, 0.0)) + tap(vec2(-texel.x, 0.0)) + tap(vec2(0.0, texel.y)) + tap(vec2(0.0, -texel.y)));
+        color += tap(texel) + tap(-texel) + tap(vec2(texel.x, -texel.y)) + tap(vec2(-texel.x, texel.y));
+        FragColor = vec4(color / 16.0, 1.0);
+        return;
+    }
+    //13 taps, every one is bilinear average of 2x2 texels:
+    //a - b - c
+    //- j - k -
+    //d - e - f
+    //- l - m -
+    //g - h - i
+    vec3 a = tap(texel * vec2(-2.0, 2.0));
+    vec3 b = tap(texel * vec2(0.0, 2.0));
+    vec3 c = tap(texel * vec2(2.0, 2.0));
+    vec3 d = tap(texel * vec2(-2.0, 0.0));
+    vec3 e = tap(vec2(0.0));
+    vec3 f = tap(texel * vec2(2.0, 0.0));
+    vec3 g = tap(texel * vec2(-2.0, -2.0));
+    vec3 h = tap(texel * vec2(0.0, -2.0));
+    vec3 i = tap(texel * vec2(2.0, -2.0));
+    vec3 j = tap(texel * vec2(-1.0, 1.0));
+    vec3 k = tap(texel * vec2(1.0, 1.0));
+    vec3 l = tap(texel * vec2(-1.0, -1.0));
+    vec3 m = tap(texel * vec2(1.0, -1.0));
+    //center box gets half of weight, four corner boxes share the rest
+    vec3 color = 0.5 * average(j, k, l, m);
+    color += 0.125 * average(a, b, d, e);
+    color += 0.125 * average(b, c, e, f);
+    color += 0.125 * average(d, e, g, h);
+    color += 0.125 * average(e, f, h, i);
+    FragColor = vec4(color, 1.0);
+}
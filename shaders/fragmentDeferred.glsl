@@ -0,0 +1,58 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+#include "lighting.glsl"
+
+//G-buffer
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+uniform mat4 lightSpaceMatrix;
+
+uniform bool visualizeNormalsWithColor;
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, coords, 0).r;
+    if (depth == 1.0) {
+        //nothing was drawn here, keep background
+        discard;
+    }
+    //depth for light sources drawn after this pass
+    gl_FragDepth = depth;
+
+    //restore position from depth
+    vec2 uv = (vec2(coords) + 0.5) / screenSize;
+    vec4 fragPos = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    fragPos /= fragPos.w;
+    vec4 fragPosWorldSpace = inverseView * fragPos;
+
+    vec4 albedo = texelFetch(gAlbedo, coords, 0);
+    vec4 specular = texelFetch(gSpecular, coords, 0);
+
+    Surface surface;
+    surface.normal = octDecode(texelFetch(gNormal, coords, 0).rg * 2.0 - 1.0);
+    surface.ambient = albedo.a * albedo.rgb;
+    surface.diffuse = albedo.rgb;
+    surface.specular = specular.rgb;
+    surface.shininess = exp2(specular.a * 10.0);
+    surface.fragPos = fragPos.xyz;
+    surface.fragPosWorldSpace = fragPosWorldSpace.xyz;
+    surface.fragPosLightSpace = lightSpaceMatrix * fragPosWorldSpace;
+    surface.viewDir = normalize(-fragPos.xyz);
+
+    if (visualizeNormalsWithColor) {
+        FragColor = vec4(surface.normal * 0.5 + 0.5, 1.0f);
+        return;
+    }
+
+    vec3 color = calcLighting(surface);
+    FragColor = vec4(color, 1.0);
+    BrightColor = calcBrightColor(color);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+//depth pre-pass for alpha tested materials, discards the same fragments as fragmentPhong
+in vec2 texCoords;
+out vec4 fragColor;
+
+struct Material {
+    int twosided;
+    float opacity;
+
+    bool hasDiffuseMap;
+    sampler2D diffuseMap;
+};
+
+uniform Material material;
+
+void main()
+{
+    if (material.hasDiffuseMap) {
+        float alpha = texture(material.diffuseMap, texCoords).a;
+        if (material.twosided != 0 && material.opacity * alpha < 0.5) {
+            discard;
+        }
+    }
+    fragColor = vec4(0.0);
+}
@@ -0,0 +1,53 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT
+{
+    vec2 texCoords;
+}
+fsIn;
+
+uniform sampler2D colorBuffer; //tone mapped image
+
+//thresholds of edge detection and length of blur along edge
+const float reduceMin = 1.0 / 128.0;
+const float reduceMul = 1.0 / 8.0;
+const float spanMax = 8.0;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(colorBuffer, 0));
+    vec2 uv = fsIn.texCoords;
+    float lumaNW = luma(texture(colorBuffer, uv + vec2(-1.0, -1.0) * texel).rgb);
+    float lumaNE = luma(texture(colorBuffer, uv + vec2(1.0, -1.0) * texel).rgb);
+    float lumaSW = luma(texture(colorBuffer, uv + vec2(-1.0, 1.0) * texel).rgb);
+    float lumaSE = luma(texture(colorBuffer, uv + vec2(1.0, 1.0) * texel).rgb);
+    vec3 colorM = texture(colorBuffer, uv).rgb;
+    float lumaM = luma(colorM);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    //direction along edge (perpendicular to luma gradient)
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * reduceMul, reduceMin);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-spanMax), vec2(spanMax)) * texel;
+
+    //two taps near pixel and four taps further along edge
+    vec3 colorA = 0.5 * (texture(colorBuffer, uv + dir * (1.0 / 3.0 - 0.5)).rgb
+        + texture(colorBuffer, uv + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 colorB = colorA * 0.5 + 0.25 * (texture(colorBuffer, uv - dir * 0.5).rgb
+        + texture(colorBuffer, uv + dir * 0.5).rgb);
+    //wider blur is used only if it didn't cross another edge
+    float lumaB = luma(colorB);
+    if (lumaB < lumaMin || lumaB > lumaMax) {
+        FragColor = vec4(colorA, 1.0);
+    } else {
+        FragColor = vec4(colorB, 1.0);
+    }
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedo; //diffuse color, ratio of ambient to diffuse
+layout (location = 1) out vec2 gNormal; //View space normal (octahedral encoding mapped to [0, 1])
+layout (location = 2) out vec4 gSpecular; //specular color, log2(shininess) / 10
+
+#include "lighting.glsl"
+#include "material.glsl"
+
+void main()
+{
+    Surface surface = sampleMaterial();
+
+    //ambient is stored as part of diffuse color to keep G-buffer compact
+    float diffuse = dot(material.diffuse, vec3(1.0 / 3.0));
+    float ambient = dot(material.ambient, vec3(1.0 / 3.0));
+    gAlbedo = vec4(surface.diffuse, clamp(ambient / max(diffuse, 1e-4), 0.0, 1.0));
+    gNormal = octEncode(surface.normal) * 0.5 + 0.5;
+    gSpecular = vec4(surface.specular, log2(max(surface.shininess, 1.0)) / 10.0);
+}
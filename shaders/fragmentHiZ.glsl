@@ -0,0 +1,33 @@
+#version 330 core
+out float FragDepth;
+
+uniform sampler2D depthBuffer; //depth texture or previous level of Hi-Z pyramid (its base level)
+uniform bool copyDepth; //copy level 0 from depth texture
+uniform vec2 sourceScale; //rendered part of depth texture (dynamic resolution)
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    if (copyDepth) {
+        FragDepth = texelFetch(depthBuffer, ivec2((vec2(coords) + 0.5) * sourceScale), 0).r;
+        return;
+    }
+    //max of 2x2 texels, the last texel also takes the rest of row/column for odd sizes
+    //base and max levels are set to previous level, so it's lod 0 here
+    ivec2 size = textureSize(depthBuffer, 0);
+    ivec2 last = max(size / 2, ivec2(1)) - 1;
+    ivec2 to = 2 * coords + 1;
+    if (coords.x == last.x) {
+        to.x = size.x - 1;
+    }
+    if (coords.y == last.y) {
+        to.y = size.y - 1;
+    }
+    float depth = 0.0;
+    for (int x = 2 * coords.x; x <= to.x; ++x) {
+        for (int y = 2 * coords.y; y <= to.y; ++y) {
+            depth = max(depth, texelFetch(depthBuffer, ivec2(x, y), 0).r);
+        }
+    }
+    FragDepth = depth;
+}
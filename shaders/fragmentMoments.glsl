@@ -0,0 +1,74 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT
+{
+    vec2 texCoords;
+}
+fsIn;
+
+//filter modes, same as MomentFilter
+#define FILTER_VSM 1
+#define FILTER_EVSM 2
+#define FILTER_SAT 3
+
+uniform sampler2D sourceBuffer; //depth map for pass 0, moments otherwise
+uniform int pass; //0 - moments from depth, 1 - Gaussian blur, 2 - pass of summed-area table
+uniform int filterMode;
+uniform vec2 evsmExponents;
+uniform bool direction; //x-axis if false, y-axis if true
+uniform int satStep; //distance between summed texels
+
+vec4 calcMoments(float depth)
+{
+    if (filterMode == FILTER_EVSM) {
+        //warp of depth in [-1, 1]
+        float d = 2.0 * depth - 1.0;
+        float positive = exp(evsmExponents.x * d);
+        float negative = -exp(-evsmExponents.y * d);
+        return vec4(positive, positive * positive, negative, negative * negative);
+    }
+    if (filterMode == FILTER_SAT) {
+        //centered, so sums lose less precision
+        float d = depth - 0.5;
+        return vec4(d, d * d, 0.0, 0.0);
+    }
+    return vec4(depth, depth * depth, 0.0, 0.0);
+}
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    if (pass == 0) {
+        //average moments of 2x2 depth texels, so half resolution is properly pre-filtered
+        ivec2 src = 2 * coords;
+        FragColor = 0.25 * (calcMoments(texelFetch(sourceBuffer, src, 0).r)
+            + calcMoments(texelFetch(sourceBuffer, src + ivec2(1, 0), 0).r)
+            + calcMoments(texelFetch(sourceBuffer, src + ivec2(0, 1), 0).r)
+            + calcMoments(texelFetch(sourceBuffer, src + ivec2(1, 1), 0).r));
+        return;
+    }
+    vec2 axis = direction ? vec2(0.0, 1.0) : vec2(1.0, 0.0);
+    if (pass == 1) {
+        //9 taps with bilinear filtering
+        float offset[3] = float[](0.0, 1.3846153846, 3.2307692308);
+        float weight[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+        vec2 texel = axis / vec2(textureSize(sourceBuffer, 0));
+        vec4 moments = texture(sourceBuffer, fsIn.texCoords) * weight[0];
+        for (int i = 1; i < 3; ++i) {
+            moments += texture(sourceBuffer, fsIn.texCoords + offset[i] * texel) * weight[i];
+            moments += texture(sourceBuffer, fsIn.texCoords - offset[i] * texel) * weight[i];
+        }
+        FragColor = moments;
+        return;
+    }
+    //sum of 4 texels (kSatTaps) satStep apart, after all passes every texel holds sum of texels up to it
+    vec4 sum = vec4(0.0);
+    for (int i = 0; i < 4; ++i) {
+        ivec2 src = coords - ivec2(axis) * i * satStep;
+        if (src.x >= 0 && src.y >= 0) {
+            sum += texelFetch(sourceBuffer, src, 0);
+        }
+    }
+    FragColor = sum;
+}
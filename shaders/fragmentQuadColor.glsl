@@ -9,38 +9,44 @@ fsIn;
 
 uniform sampler2D colorBuffer;
 uniform sampler2D bloomBuffer;
-uniform bool direction;
-uniform bool gaussFilter;
 uniform bool addBloom;
+uniform float bloomScale = 1.0; //levels of bloom chain are summed, this keeps brightness
 uniform float exposure = 1.5;
 uniform float gamma = 0.9;
+uniform vec2 uvScale = vec2(1.0); //rendered part of colorBuffer (dynamic resolution)
+uniform bool sharpen; //contrast adaptive sharpening after bilinear upscale
 
-void main()
+vec3 sampleColor(vec2 offset)
 {
-    float offset[4] = float[](0.0, 1.411764705882353, 3.2941176470588234, 5.176470588235294);
-    float weight[4] = float[](0.1964825501511404, 0.2969069646728344, 0.09447039785044732, 0.010381362401148057);
+    vec2 halfTexel = 0.5 / vec2(textureSize(colorBuffer, 0));
+    return texture(colorBuffer, clamp(fsIn.texCoords * uvScale + offset, halfTexel, uvScale - halfTexel)).rgb;
+}
 
-    vec3 color = texture(colorBuffer, fsIn.texCoords).rgb;
-    if (gaussFilter) {
-        color *= weight[0];
-        vec2 size = textureSize(colorBuffer, 0);
-        for (int i = 1; i < 4; ++i) {
-            vec2 coord1 = fsIn.texCoords;
-            vec2 coord2 = fsIn.texCoords;
-            if (direction) {
-                coord1 += vec2(0.0, offset[i]) / size.y;
-                coord2 -= vec2(0.0, offset[i]) / size.y;
-            } else {
-                coord1 += vec2(offset[i], 0.0) / size.x;
-                coord2 -= vec2(offset[i], 0.0) / size.x;
-            }
-            color += texture(colorBuffer, coord1).rgb * weight[i];
-            color += texture(colorBuffer, coord2).rgb * weight[i]; 
-        }
+//sharpen with cross of neighbours, weight is lower where local contrast is high,
+//so edges don't ring (similar to AMD CAS / FSR1 RCAS)
+vec3 sharpenColor(vec3 center)
+{
+    vec2 texel = 1.0 / vec2(textureSize(colorBuffer, 0));
+    vec3 n = sampleColor(vec2(0.0, texel.y));
+    vec3 s = sampleColor(vec2(0.0, -texel.y));
+    vec3 e = sampleColor(vec2(texel.x, 0.0));
+    vec3 w = sampleColor(vec2(-texel.x, 0.0));
+    vec3 minColor = min(center, min(min(n, s), min(e, w)));
+    vec3 maxColor = max(center, max(max(n, s), max(e, w)));
+    vec3 amount = sqrt(clamp(min(minColor, 1.0 - maxColor) / max(maxColor, 1e-4), 0.0, 1.0));
+    vec3 weight = -amount * 0.2;
+    return max((center + (n + s + e + w) * weight) / (1.0 + 4.0 * weight), 0.0);
+}
+
+void main()
+{
+    vec3 color = sampleColor(vec2(0.0));
+    if (sharpen) {
+        color = sharpenColor(color);
     }
     if (addBloom) {
         vec3 bloomColor = texture(bloomBuffer, fsIn.texCoords).rgb;
-        color += bloomColor;
+        color += bloomColor * bloomScale;
         // tone mapping
         color = vec3(1.0) - exp(-color * exposure);
         // gamma correction 
@@ -7,32 +7,19 @@ in VS_OUT
 }
 fsIn;
 
-uniform sampler2D shadowMap;
-uniform bool direction;
-uniform bool gaussFilter;
+uniform sampler2D shadowMap; //depth of directional shadow map
+uniform sampler2DArray cascadeMap; //depth of shadow cascades
+uniform int numCascades; //cascades are shown side by side, with no cascades shadowMap is shown
 
 void main()
 {
-    float offset[3] = float[](0.0, 1.3846153846, 3.2307692308);
-    float weight[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
-
-    vec2 depth = texture(shadowMap, fsIn.texCoords).rg;
-    if (gaussFilter) {
-        depth *= weight[0];
-        vec2 size = textureSize(shadowMap, 0);
-        for (int i = 1; i < 3; ++i) {
-            vec2 coord1 = fsIn.texCoords;
-            vec2 coord2 = fsIn.texCoords;
-            if (direction) {
-                coord1 += vec2(0.0, offset[i]) / size.y;
-                coord2 -= vec2(0.0, offset[i]) / size.y;
-            } else {
-                coord1 += vec2(offset[i], 0.0) / size.x;
-                coord2 -= vec2(offset[i], 0.0) / size.x;
-            }
-            depth += texture(shadowMap, coord1).rg * weight[i];
-            depth += texture(shadowMap, coord2).rg * weight[i]; 
-        }
+    float depth;
+    if (numCascades > 0) {
+        float x = fsIn.texCoords.x * numCascades;
+        float layer = min(floor(x), float(numCascades - 1));
+        depth = texture(cascadeMap, vec3(x - layer, fsIn.texCoords.y, layer)).r;
+    } else {
+        depth = texture(shadowMap, fsIn.texCoords).r;
     }
-    FragColor = vec4(depth.rg, 0.0, 1.0);
-}
\ No newline at end of file
+    FragColor = vec4(vec3(depth), 1.0);
+}
@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT
+{
+    vec2 texCoords;
+}
+fsIn;
+
+uniform sampler2D colorBuffer; //HDR color of this frame (jittered)
+uniform sampler2D historyBuffer; //accumulated color of previous frames
+uniform sampler2D depthBuffer;
+uniform mat4 reprojection; //from NDC of this frame to clip space of previous one
+uniform bool hasHistory;
+uniform vec2 uvScale; //rendered part of textures (dynamic resolution)
+uniform float feedback = 0.9; //weight of history
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    vec3 color = texelFetch(colorBuffer, coords, 0).rgb;
+    if (!hasHistory) {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    //where this pixel was in previous frame (only camera motion is known)
+    float depth = texelFetch(depthBuffer, coords, 0).r;
+    vec4 previous = reprojection * vec4(fsIn.texCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec2 previousCoords = previous.xy / previous.w * 0.5 + 0.5;
+    if (any(lessThan(previousCoords, vec2(0.0))) || any(greaterThan(previousCoords, vec2(1.0)))) {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    //history outside of colors around pixel is stale (disocclusion, moving objects), clamp it
+    vec3 minColor = color;
+    vec3 maxColor = color;
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            vec3 neighbour = texelFetch(colorBuffer, coords + ivec2(x, y), 0).rgb;
+            minColor = min(minColor, neighbour);
+            maxColor = max(maxColor, neighbour);
+        }
+    }
+    vec3 history = clamp(texture(historyBuffer, previousCoords * uvScale).rgb, minColor, maxColor);
+
+    //weights by inverse luminance, so bright samples don't flicker
+    float historyWeight = feedback / (1.0 + luminance(history));
+    float colorWeight = (1.0 - feedback) / (1.0 + luminance(color));
+    FragColor = vec4((history * historyWeight + color * colorWeight) / (historyWeight + colorWeight), 1.0);
+}
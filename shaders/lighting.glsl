@@ -0,0 +1,517 @@
+//light sources and Phong lighting shared by forward and deferred shading
+//(included with #include, so no #version here)
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    sampler2D shadowMap; //filtered moments (see MomentShadowMap)
+    sampler2DShadow shadowMapDepth; //depth with hardware comparison for PCF
+    int shadowFilter; //one of SHADOW_* below
+};
+
+//filters of directional shadow map, moment ones are the same as MomentFilter
+#define SHADOW_PCF 0
+#define SHADOW_VSM 1
+#define SHADOW_EVSM 2
+#define SHADOW_SAT 3
+
+struct PointLight {
+    vec3 position; //in View space
+    vec3 positionWorldSpace;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant; //parameters for attenuation
+    float linear;
+    float quadratic;
+    float radius; //light is below threshold beyond this distance (not used for spotlight)
+
+    vec4 atlasRect; //tiles in pointShadowAtlas: offset and face size along x and y in [0, 1]
+    int atlasFaces; //mask of valid faces
+};
+
+struct SpotLight {
+    PointLight pointLight;
+
+    vec3 direction; // direction the spotlight is aiming at
+    float cutOff; //cutoff angle specifing the spotlight's radius
+    float outerCutOff; //cutoff angle specifing outer radius to smooth the spotlight
+};
+
+//everything needed to light one fragment
+struct Surface {
+    vec3 ambient; //ambient color (with diffuse map applied)
+    vec3 diffuse; //diffuse color (with diffuse map applied)
+    vec3 specular; //specular color (with specular map applied)
+    float shininess;
+    vec3 normal; //in View space
+    vec3 fragPos; //in View space
+    vec3 fragPosWorldSpace;
+    vec4 fragPosLightSpace;
+    vec3 viewDir; //direction from fragment to viewer (normalized)
+};
+
+//light sources
+#define NR_POINT_LIGHTS 6 //point lights with shadow maps
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform DirLight dirLight;
+uniform SpotLight spotLight;
+uniform bool spotlightOn;
+uniform float farPlane;
+uniform int shadowTaps; //4, 8 or 16 taps for PCF
+uniform vec2 evsmExponents; //positive and negative warp of EVSM
+uniform float momentsMinVariance; //against precision loss of moments
+uniform float satKernel; //smallest box filter of summed-area table in texels
+uniform sampler2DShadow pointShadowAtlas; //faces of point lights as 3x2 blocks of tiles, distance to light / farPlane
+
+//cascaded shadow map of directional light (used instead of dirLight.shadowMap if numCascades > 0)
+#define MAX_CASCADES 4
+uniform int numCascades;
+uniform sampler2DArrayShadow cascadeShadowMap;
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+uniform vec4 cascadeSplits; //far distance of every cascade in View space
+uniform vec4 cascadeBias; //about one texel of every cascade in [0, 1] depth
+
+//clustered lights (light lists are built on CPU every frame, see LightClusters)
+uniform samplerBuffer clusterLights; //2 texels per light: position in View space and radius, color and quadratic attenuation
+uniform usamplerBuffer clusterGrid; //2 texels per cluster: offset of list and count | shadowed lights mask << 16, then lists
+uniform vec3 clusterDims;
+uniform vec2 clusterDepthParams; //slice = log(depth) * x + y
+uniform vec2 screenSize;
+
+vec3 calcDiffuse(
+    vec3 lightDir, //direction from fragment to the light source (normalized)
+    vec3 norm, //fragment normal
+    vec3 materialDiffuse) //diffuse color
+{
+    float diff = max(dot(norm, lightDir), 0.0);
+    return diff * materialDiffuse;
+}
+
+vec3 calcSpecular(
+    vec3 lightDir, //direction from fragment to the light source (normalized)
+    vec3 norm, //fragment normal
+    vec3 viewDir, //direction from fragment to viewer (normalized)
+    vec3 materialSpecular, //specular color
+    float shininess) //shininess of material
+{
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    return materialSpecular * spec;
+}
+
+//Poisson disk, every tap is filtered by hardware comparison (2x2 texels)
+const vec2 poissonDisk[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+    vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420),
+    vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590),
+    vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+
+//rotation of Poisson disk that changes from pixel to pixel (interleaved gradient noise),
+//turns banding of few taps into noise
+mat2 calcTapRotation()
+{
+    float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float angle = 6.28318530 * noise;
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat2(c, s, -s, c);
+}
+
+float calcDirShadowPCF(DirLight light, vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
+{
+    //transform to [0, 1]
+    vec3 projCoords = fragPosLightSpace.xyz * 0.5 + 0.5;
+    vec2 texelSize = 1.0 / textureSize(light.shadowMapDepth, 0);
+    //bias to remove shadow achne
+    float bias = max(0.005 * (1.0 - dot(normal, lightDir)), 0.005);
+    mat2 rotation = calcTapRotation();
+    float shadow = 0.0;
+    //taps cover about the same area as 5x5 texels
+    int numTaps = clamp(shadowTaps, 1, 16);
+    for (int i = 0; i < numTaps; ++i) {
+        vec2 offset = rotation * poissonDisk[i] * 2.0 * texelSize;
+        shadow += texture(light.shadowMapDepth, vec3(projCoords.xy + offset, projCoords.z - bias));
+    }
+    return shadow / float(numTaps);
+}
+
+float calcCascadeShadow(Surface surface, vec3 lightDir)
+{
+    float depth = -surface.fragPos.z;
+    if (depth > cascadeSplits[numCascades - 1]) {
+        //beyond shadow distance
+        return 1.0;
+    }
+    int cascade = 0;
+    while (cascade < numCascades - 1 && depth > cascadeSplits[cascade]) {
+        ++cascade;
+    }
+    //far cascades are updated every few frames, fragment may be outside of the last one rendered
+    vec3 projCoords;
+    for (; cascade < numCascades; ++cascade) {
+        vec4 fragPosLightSpace = cascadeMatrices[cascade] * vec4(surface.fragPosWorldSpace, 1.0);
+        projCoords = fragPosLightSpace.xyz * 0.5 + 0.5;
+        if (all(greaterThan(projCoords.xy, vec2(0.0))) && all(lessThan(projCoords.xy, vec2(1.0)))) {
+            break;
+        }
+    }
+    if (cascade == numCascades) {
+        return 1.0;
+    }
+
+    vec2 texelSize = 1.0 / vec2(textureSize(cascadeShadowMap, 0).xy);
+    //more bias on surfaces at grazing angles
+    float bias = cascadeBias[cascade] * (1.0 + 2.0 * (1.0 - max(dot(surface.normal, lightDir), 0.0)));
+    mat2 rotation = calcTapRotation();
+    float shadow = 0.0;
+    int numTaps = clamp(shadowTaps, 1, 16);
+    for (int i = 0; i < numTaps; ++i) {
+        vec2 offset = rotation * poissonDisk[i] * 2.0 * texelSize;
+        shadow += texture(cascadeShadowMap, vec4(projCoords.xy + offset, float(cascade), projCoords.z - bias));
+    }
+    return shadow / float(numTaps);
+}
+
+//upper bound of lit fraction from mean and variance of occluder depth
+float calcChebyshev(float mean, float variance, float depth)
+{
+    if (depth <= mean) {
+        return 1.0;
+    }
+    float diff = depth - mean;
+    return variance / (variance + diff * diff);
+}
+
+//average of depth and depth^2 (both centered at 0.5) over box of summed-area table
+vec2 calcSATMoments(DirLight light, vec2 uv, vec2 footprint)
+{
+    vec2 size = vec2(textureSize(light.shadowMap, 0));
+    //box is at least as wide as screen pixel in shadow map, so minification doesn't alias
+    vec2 halfWidth = 0.5 * max(vec2(satKernel), footprint * size) / size;
+    //sums are stored at texel centers
+    vec2 lo = clamp(uv - halfWidth, vec2(0.5) / size, vec2(1.0) - vec2(0.5) / size);
+    vec2 hi = clamp(uv + halfWidth, vec2(0.5) / size, vec2(1.0) - vec2(0.5) / size);
+    vec2 area = max((hi - lo) * size, vec2(1.0));
+    vec2 sum = texture(light.shadowMap, hi).rg
+        - texture(light.shadowMap, vec2(lo.x, hi.y)).rg
+        - texture(light.shadowMap, vec2(hi.x, lo.y)).rg
+        + texture(light.shadowMap, lo).rg;
+    return sum / (area.x * area.y);
+}
+
+float calcDirShadowVSM(DirLight light, vec4 fragPosLightSpace)
+{
+    //transform to [0, 1]
+    vec3 projCoords = fragPosLightSpace.xyz * 0.5 + 0.5;
+    //derivatives before any branch on fragment data
+    vec2 footprint = fwidth(projCoords.xy);
+    if (any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0)))) {
+        //outside of shadow map
+        return 1.0;
+    }
+    float bias = 0.05;
+    float depth = projCoords.z - bias;
+
+    if (light.shadowFilter == SHADOW_EVSM) {
+        vec4 moments = texture(light.shadowMap, projCoords.xy);
+        float d = 2.0 * depth - 1.0;
+        float positive = exp(evsmExponents.x * d);
+        float negative = -exp(-evsmExponents.y * d);
+        //minimal variance is scaled by slope of warp
+        float positiveMin = momentsMinVariance * evsmExponents.x * evsmExponents.x * positive * positive;
+        float negativeMin = momentsMinVariance * evsmExponents.y * evsmExponents.y * negative * negative;
+        float positiveLit = calcChebyshev(moments.x, max(moments.y - moments.x * moments.x, positiveMin), positive);
+        float negativeLit = calcChebyshev(moments.z, max(moments.w - moments.z * moments.z, negativeMin), negative);
+        return min(positiveLit, negativeLit);
+    }
+    vec2 moments;
+    if (light.shadowFilter == SHADOW_SAT) {
+        vec2 centered = calcSATMoments(light, projCoords.xy, footprint);
+        moments = vec2(centered.x + 0.5, centered.y - centered.x * centered.x);
+    } else {
+        moments = texture(light.shadowMap, projCoords.xy).rg;
+        moments.y -= moments.x * moments.x;
+    }
+    return calcChebyshev(moments.x, max(moments.y, momentsMinVariance), depth);
+}
+
+vec3 calcDirLight(
+    DirLight light, //light
+    Surface surface) //lit fragment
+{
+    vec3 lightDir = normalize(-light.direction);
+
+    //ambient
+    vec3 ambient = light.ambient * surface.ambient;
+
+    //diffuse
+    vec3 diffuse = light.diffuse * calcDiffuse(lightDir, surface.normal, surface.diffuse);
+
+    //specular
+    vec3 specular = light.specular * calcSpecular(lightDir, surface.normal, surface.viewDir, surface.specular, surface.shininess);
+
+    float shadow;
+    if (numCascades > 0) {
+        shadow = calcCascadeShadow(surface, lightDir);
+    } else if (light.shadowFilter == SHADOW_PCF) {
+        shadow = calcDirShadowPCF(light, surface.fragPosLightSpace, surface.normal, lightDir);
+    } else {
+        shadow = calcDirShadowVSM(light, surface.fragPosLightSpace);
+    }
+
+    return ambient + shadow * (diffuse + specular);
+}
+
+float calcAttenuation(
+    PointLight light, //light
+    vec3 fragPos) //fragment postion in View space
+{
+    float dist = length(light.position - fragPos);
+    return 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist);
+}
+
+//goes smoothly to zero at radius, so cut off light has no visible edge
+float calcWindow(float dist, float radius)
+{
+    float window = clamp(1.0 - pow(dist / radius, 4.0), 0.0, 1.0);
+    return window * window;
+}
+
+//right, up and forward of cube faces (+X, -X, +Y, -Y, +Z, -Z), same as in ShadowAtlas
+const vec3 faceRight[6] = vec3[](
+    vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0),
+    vec3(1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0)
+);
+const vec3 faceUp[6] = vec3[](
+    vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0)
+);
+const vec3 faceForward[6] = vec3[](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0)
+);
+
+//hardware comparison with face of point light in atlas that dir points to
+float sampleShadowAtlas(PointLight light, vec3 dir, float refDepth)
+{
+    vec3 absDir = abs(dir);
+    int face;
+    if (absDir.x >= absDir.y && absDir.x >= absDir.z) {
+        face = dir.x > 0.0 ? 0 : 1;
+    } else if (absDir.y >= absDir.z) {
+        face = dir.y > 0.0 ? 2 : 3;
+    } else {
+        face = dir.z > 0.0 ? 4 : 5;
+    }
+    if ((light.atlasFaces & (1 << face)) == 0) {
+        //face wasn't rendered yet
+        return 1.0;
+    }
+    vec2 ndc = vec2(dot(faceRight[face], dir), dot(faceUp[face], dir)) / dot(faceForward[face], dir);
+    //stay half a texel inside of tile, so filtering doesn't read neighbour faces
+    //(atlas isn't square, so face size differs along x and y in texture coordinates)
+    vec2 halfTexel = 0.5 / (light.atlasRect.zw * vec2(textureSize(pointShadowAtlas, 0)));
+    vec2 uv = clamp(ndc * 0.5 + 0.5, halfTexel, vec2(1.0) - halfTexel);
+    vec2 tile = vec2(float(face % 3), float(face / 3));
+    return texture(pointShadowAtlas, vec3(light.atlasRect.xy + (tile + uv) * light.atlasRect.zw, refDepth));
+}
+
+float calcPointShadowPCF(PointLight light, vec3 fragPosWorldSpace, vec3 lightPosWorldSpace)
+{
+    if (light.atlasRect.z == 0.0) {
+        //light didn't get space in atlas
+        return 1.0;
+    }
+    //vector from light source to fragment
+    vec3 fragToLight = fragPosWorldSpace - lightPosWorldSpace;
+    float currentDepth = length(fragToLight);
+    float bias = 10.0;
+    //compared with distance to closest fragment in [0, 1]
+    float refDepth = (currentDepth - bias) / farPlane;
+
+    //taps on disk perpendicular to direction, about two texels of face wide
+    vec3 dir = fragToLight / currentDepth;
+    vec3 up = abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, dir));
+    vec3 bitangent = cross(dir, tangent);
+    float faceResolution = light.atlasRect.z * float(textureSize(pointShadowAtlas, 0).x);
+    float radius = 4.0 / faceResolution;
+    mat2 rotation = calcTapRotation();
+    float shadow = 0.0;
+    int numTaps = clamp(shadowTaps, 1, 16);
+    for (int i = 0; i < numTaps; ++i) {
+        vec2 offset = rotation * poissonDisk[i] * radius;
+        shadow += sampleShadowAtlas(light, dir + tangent * offset.x + bitangent * offset.y, refDepth);
+    }
+    return shadow / float(numTaps);
+}
+
+vec3 calcPointLight(
+    PointLight light, //light
+    Surface surface) //lit fragment
+{
+    float dist = length(light.position - surface.fragPos);
+    if (dist >= light.radius) {
+        //light is too weak here, skip shadow lookups
+        return vec3(0.0);
+    }
+    vec3 lightDir = (light.position - surface.fragPos) / dist;
+
+    //attenuation
+    float attenuation = calcAttenuation(
+        light,
+        surface.fragPos) * calcWindow(dist, light.radius);
+
+    //ambient
+    vec3 ambient = light.ambient * surface.ambient;
+
+    //diffuse
+    vec3 diffuse = light.diffuse * calcDiffuse(lightDir, surface.normal, surface.diffuse);
+
+    //specular
+    vec3 specular = light.specular * calcSpecular(lightDir, surface.normal, surface.viewDir, surface.specular, surface.shininess);
+
+    float shadow = calcPointShadowPCF(light, surface.fragPosWorldSpace, light.positionWorldSpace);
+
+    return (ambient + shadow*(diffuse + specular)) * attenuation;
+}
+
+vec3 calcSpotLight(
+    SpotLight light, //light
+    Surface surface) //lit fragment
+{
+    vec3 lightDir = normalize(light.pointLight.position - surface.fragPos);
+
+    //calculate intensity:
+    //0 if fragment is outside of spotlight
+    //(0, 1) in outer 'ring' to smooth spotlight
+    //1 inside of spotlight
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.outerCutOff - light.cutOff;
+    float intensity = clamp((light.outerCutOff - theta) / epsilon, 0.0, 1.0);
+
+    //attenuation
+    float attenuation = calcAttenuation(
+        light.pointLight,
+        surface.fragPos);
+
+    //ambient
+    vec3 ambient = light.pointLight.ambient * surface.ambient;
+
+    //diffuse
+    vec3 diffuse = light.pointLight.diffuse * calcDiffuse(lightDir, surface.normal, surface.diffuse);
+
+    //specular
+    vec3 specular = light.pointLight.specular * calcSpecular(lightDir, surface.normal, surface.viewDir, surface.specular, surface.shininess);
+
+    diffuse *= intensity;
+    specular *= intensity;
+
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+//index of cluster with fragment (fragPos in View space)
+int calcClusterIndex(vec3 fragPos)
+{
+    ivec3 dims = ivec3(clusterDims);
+    ivec2 tile = ivec2(gl_FragCoord.xy / screenSize * clusterDims.xy);
+    int slice = int(log(-fragPos.z) * clusterDepthParams.x + clusterDepthParams.y);
+    tile = clamp(tile, ivec2(0), dims.xy - 1);
+    slice = clamp(slice, 0, dims.z - 1);
+    return (slice * dims.y + tile.y) * dims.x + tile.x;
+}
+
+//point light without shadow map, there is no light beyond its radius
+vec3 calcClusteredLight(
+    int idx, //index of light
+    Surface surface) //lit fragment
+{
+    vec4 positionRadius = texelFetch(clusterLights, 2 * idx);
+    vec4 colorQuadratic = texelFetch(clusterLights, 2 * idx + 1);
+    vec3 lightDir = positionRadius.xyz - surface.fragPos;
+    float dist = length(lightDir);
+    lightDir /= dist;
+
+    float attenuation = calcWindow(dist, positionRadius.w) / (1.0 + colorQuadratic.w * dist * dist);
+
+    vec3 diffuse = calcDiffuse(lightDir, surface.normal, surface.diffuse);
+    vec3 specular = calcSpecular(lightDir, surface.normal, surface.viewDir, surface.specular, surface.shininess);
+    return colorQuadratic.rgb * (diffuse + specular) * attenuation;
+}
+
+//all light sources
+vec3 calcLighting(Surface surface)
+{
+    //directional light
+    vec3 color = calcDirLight(dirLight, surface);
+
+    //only lights that reach cluster of fragment
+    int cluster = calcClusterIndex(surface.fragPos);
+    int offset = int(texelFetch(clusterGrid, 2 * cluster).r);
+    uint packed = texelFetch(clusterGrid, 2 * cluster + 1).r;
+    int count = int(packed & 0xFFFFu);
+    uint shadowedMask = packed >> 16;
+
+    //point lights with shadows
+    for (int i = 0; i < NR_POINT_LIGHTS; ++i) {
+        if ((shadowedMask & (1u << i)) != 0u) {
+            color += calcPointLight(pointLights[i], surface);
+        }
+    }
+
+    //point lights without shadows
+    for (int i = 0; i < count; ++i) {
+        int idx = int(texelFetch(clusterGrid, offset + i).r);
+        color += calcClusteredLight(idx, surface);
+    }
+
+    if (spotlightOn) {
+        //spotlight
+        color += calcSpotLight(spotLight, surface);
+    }
+    return color;
+}
+
+//bright part of color for bloom
+vec4 calcBrightColor(vec3 color)
+{
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    if (brightness > 0.9) {
+        return vec4(color, 1.0);
+    }
+    return vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+//map unit vector to [-1, 1]^2 and back (octahedral encoding)
+vec2 octEncode(vec3 v)
+{
+    v /= abs(v.x) + abs(v.y) + abs(v.z);
+    vec2 e = v.xy;
+    if (v.z < 0.0) {
+        vec2 signNotZero = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+        e = (1.0 - abs(v.yx)) * signNotZero;
+    }
+    return e;
+}
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        vec2 signNotZero = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+        v.xy = (1.0 - abs(v.yx)) * signNotZero;
+    }
+    return normalize(v);
+}
@@ -0,0 +1,67 @@
+//material of rasterized fragment, needs lighting.glsl for Surface
+//(included with #include, so no #version here)
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+    int twosided;
+    float opacity;
+
+    bool hasDiffuseMap;
+    sampler2D diffuseMap;
+    bool hasSpecularMap;
+    sampler2D specularMap;
+    bool hasNormalMap;
+    sampler2D normalMap;
+};
+
+uniform Material material;
+
+in VS_OUT
+{
+    vec3 normal;
+    vec3 fragPos;
+    vec4 fragPosLightSpace;
+    vec4 fragPosWorldSpace;
+    vec2 texCoords;
+    mat3 TBN;
+}
+fsIn;
+
+//sample material maps for current fragment, transparent fragments of twosided materials are discarded
+Surface sampleMaterial()
+{
+    Surface surface;
+    if (material.hasNormalMap) {
+        vec3 normal = texture(material.normalMap, fsIn.texCoords).rgb;
+        normal = normal * 2.0 - 1.0;
+        surface.normal = normalize(fsIn.TBN * normal);
+    } else {
+        surface.normal = normalize(fsIn.normal);
+    }
+
+    vec3 diffuseMapVal = vec3(1.0);
+    if (material.hasDiffuseMap) {
+        vec4 color = texture(material.diffuseMap, fsIn.texCoords);
+        if (material.twosided != 0 && material.opacity * color.a < 0.5) {
+            discard;
+        }
+        diffuseMapVal = vec3(color);
+    }
+    vec3 specularMapVal = vec3(1.0);
+    if (material.hasSpecularMap) {
+        specularMapVal =  texture(material.specularMap, fsIn.texCoords).rgb;
+    }
+
+    surface.ambient = material.ambient * diffuseMapVal;
+    surface.diffuse = material.diffuse * diffuseMapVal;
+    surface.specular = material.specular * specularMapVal;
+    surface.shininess = material.shininess;
+    surface.fragPos = fsIn.fragPos;
+    surface.fragPosWorldSpace = fsIn.fragPosWorldSpace.xyz;
+    surface.fragPosLightSpace = fsIn.fragPosLightSpace;
+    surface.viewDir = normalize(-fsIn.fragPos);
+    return surface;
+}
@@ -1,10 +1,18 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 5) in mat4 aModel; //per-instance
 
-uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+uniform mat4 lightSpaceMatrix; //projection * view for depth pre-pass
+
+out vec2 texCoords;
+
+//same expression as in vertexPhong, so depth pre-pass matches lighting pass exactly
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0f);
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * worldPos;
+    texCoords = aTexCoords;
 }
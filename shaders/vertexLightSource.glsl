@@ -1,11 +1,16 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aModel; //per-instance, one instance per light source
 
-uniform mat4 model;
+#define NR_POINT_LIGHTS 6
+uniform vec3 lightColors[NR_POINT_LIGHTS];
 uniform mat4 view;
 uniform mat4 projection;
 
+flat out vec3 lightColor;
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+    lightColor = lightColors[gl_InstanceID];
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #version 330 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
+layout(location = 0) in vec3 aPos; //may be quantized, dequantization is applied with aModel
+layout(location = 1) in vec2 aNormal; //octahedral encoding
 layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in vec3 aTangent;
-layout(location = 4) in vec3 aBitangent;
+layout(location = 3) in vec4 aTangent; //octahedral encoding and bitangent sign
+layout(location = 5) in mat4 aModel; //per-instance
+layout(location = 9) in mat3 aNormalMatrix; //per-instance, transpose(inverse(model))
 
 struct Material {
     vec3 ambient;
@@ -21,10 +22,8 @@ struct Material {
     sampler2D normalMap;
 };
 
-uniform mat4 model;
 uniform mat4 view;
-uniform mat4 projection;
-uniform mat3 normalMatrix;
+uniform mat4 viewProjection; //projection * view
 uniform mat4 lightSpaceMatrix;
 uniform Material material;
 
@@ -37,25 +36,46 @@ out VS_OUT {
     mat3 TBN;
 } vsOut;
 
+//must match depth pre-pass for GL_EQUAL depth test
+invariant gl_Position;
+
+//decode unit vector from octahedral encoding
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        vec2 signNotZero = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+        v.xy = (1.0 - abs(v.yx)) * signNotZero;
+    }
+    return normalize(v);
+}
+
 void main()
 {
-    mat4 MV = view * model;
-    vec4 frag = MV * vec4(aPos, 1.0);
-    gl_Position = projection * frag;
- 
+    vec3 normal = octDecode(aNormal);
+
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
+    vec4 frag = view * worldPos;
+    gl_Position = viewProjection * worldPos;
+
+    //view is orthonormal, so normal matrix of view * model is mat3(view) * normal matrix of model
+    mat3 normalMatrix = mat3(view) * aNormalMatrix;
+
     //calculate TBN
     mat3 TBN = mat3(1.0f);
     if (material.hasNormalMap) {
-        vec3 T = normalMatrix * normalize(aTangent);
-        vec3 B = normalMatrix * normalize(aBitangent);
-        vec3 N = normalMatrix * normalize(aNormal);
+        vec3 tangent = octDecode(aTangent.xy);
+        vec3 bitangent = aTangent.z * cross(normal, tangent);
+        vec3 T = normalMatrix * tangent;
+        vec3 B = normalMatrix * bitangent;
+        vec3 N = normalMatrix * normal;
         TBN = mat3(T, B, N);
     }
 
-    vsOut.normal = normalMatrix * aNormal;
+    vsOut.normal = normalMatrix * normal;
     vsOut.fragPos = vec3(frag);
-    vsOut.fragPosLightSpace = lightSpaceMatrix * model * vec4(aPos, 1.0);
-    vsOut.fragPosWorldSpace = model * vec4(aPos, 1.0);
+    vsOut.fragPosLightSpace = lightSpaceMatrix * worldPos;
+    vsOut.fragPosWorldSpace = worldPos;
     vsOut.texCoords = aTexCoords;
     vsOut.TBN = TBN;
 }
\ No newline at end of file
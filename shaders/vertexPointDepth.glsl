@@ -1,9 +0,0 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-
-uniform mat4 model;
-
-void main()
-{
-    gl_Position = model * vec4(aPos, 1.0); //output in world space
-}
\ No newline at end of file
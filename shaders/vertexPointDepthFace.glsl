@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aModel; //per-instance
+
+uniform mat4 lightSpaceMatrix; //projection and view of one cube face
+
+out vec4 fragPos;
+
+void main()
+{
+    fragPos = aModel * vec4(aPos, 1.0); //in world space
+    gl_Position = lightSpaceMatrix * fragPos;
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "AntiAliasing.h"
+#include <stdexcept>
+
+namespace {
+
+//jitter repeats every this many frames
+const std::uint32_t kJitterPeriod = 8;
+
+//low discrepancy sequence in [0, 1)
+float halton(std::uint32_t index, std::uint32_t base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f / base;
+    while (index > 0) {
+        result += fraction * (index % base);
+        index /= base;
+        fraction /= base;
+    }
+    return result;
+}
+
+GLuint createTarget(std::uint32_t width, std::uint32_t height, GLenum internalFormat)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GL_CHECK_ERRORS;
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    GL_CHECK_ERRORS;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+GLuint createFramebuffer(GLuint texture)
+{
+    GLuint FBO;
+    glGenFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    GL_CHECK_ERRORS;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return FBO;
+}
+
+}
+
+AntiAliasingMode AntiAliasing::ModeFromString(const std::string& name)
+{
+    if (name == "msaa") {
+        return AntiAliasingMode::MSAA;
+    }
+    if (name == "fxaa") {
+        return AntiAliasingMode::FXAA;
+    }
+    if (name == "taa") {
+        return AntiAliasingMode::TAA;
+    }
+    throw std::runtime_error("Unknown anti-aliasing mode " + name);
+}
+
+std::string AntiAliasing::ModeToString(AntiAliasingMode mode)
+{
+    switch (mode) {
+    case AntiAliasingMode::FXAA:
+        return "fxaa";
+    case AntiAliasingMode::TAA:
+        return "taa";
+    default:
+        return "msaa";
+    }
+}
+
+void AntiAliasing::Setup(std::uint32_t width_, std::uint32_t height_, AntiAliasingMode mode_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    width = width_;
+    height = height_;
+    mode = mode_;
+    if (mode == AntiAliasingMode::FXAA) {
+        //FXAA works on perceptual colors, 8 bits are enough after tone mapping
+        ldrTexture = createTarget(width, height, GL_RGBA8);
+        ldrFBO = createFramebuffer(ldrTexture);
+    } else if (mode == AntiAliasingMode::TAA) {
+        for (auto& texture : historyTextures) {
+            texture = createTarget(width, height, GL_RGB16F);
+        }
+        historyFBO = createFramebuffer(historyTextures[0]);
+    }
+    current = 0;
+    hasHistory = false;
+    frameIndex = 0;
+    isLoaded = true;
+}
+
+void AntiAliasing::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    if (mode == AntiAliasingMode::FXAA) {
+        glDeleteFramebuffers(1, &ldrFBO);
+        glDeleteTextures(1, &ldrTexture);
+        ldrFBO = 0;
+    } else if (mode == AntiAliasingMode::TAA) {
+        glDeleteFramebuffers(1, &historyFBO);
+        glDeleteTextures(2, historyTextures);
+    }
+    GL_CHECK_ERRORS;
+    isLoaded = false;
+}
+
+glm::mat4 AntiAliasing::JitterProjection(const glm::mat4& projection, const glm::ivec2& renderSize)
+{
+    if (mode != AntiAliasingMode::TAA) {
+        return projection;
+    }
+    //offset within pixel in [-0.5, 0.5], moves image by fraction of pixel in NDC
+    std::uint32_t index = frameIndex % kJitterPeriod + 1;
+    glm::vec2 offset(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+    ++frameIndex;
+    glm::mat4 jittered = projection;
+    jittered[2][0] += 2.0f * offset.x / renderSize.x;
+    jittered[2][1] += 2.0f * offset.y / renderSize.y;
+    return jittered;
+}
+
+GLuint AntiAliasing::ResolveTemporal(
+    GLuint colorTexture,
+    GLuint depthTexture,
+    const glm::vec2& uvScale,
+    ShaderProgram& program,
+    GLuint quadVAO,
+    const glm::mat4& viewProjection,
+    const glm::mat4& unjitteredViewProjection)
+{
+    if (mode != AntiAliasingMode::TAA) {
+        return colorTexture;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, historyFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[current], 0);
+    GL_CHECK_ERRORS;
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(program.ProgramObj);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, historyTextures[1 - current]);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    program.SetUniform("colorBuffer", 0);
+    program.SetUniform("historyBuffer", 1);
+    program.SetUniform("depthBuffer", 2);
+    program.SetUniform("hasHistory", hasHistory);
+    program.SetUniform("uvScale", uvScale);
+    //from NDC of this frame to clip space of previous one
+    program.SetUniform("reprojection", previousViewProjection * glm::inverse(viewProjection));
+    glBindVertexArray(quadVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+    GL_CHECK_ERRORS;
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    GLuint result = historyTextures[current];
+    current = 1 - current;
+    hasHistory = true;
+    previousViewProjection = unjitteredViewProjection;
+    return result;
+}
+
+void AntiAliasing::ApplyFXAA(ShaderProgram& program, GLuint quadVAO, GLuint outputFBO)
+{
+    if (mode != AntiAliasingMode::FXAA) {
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(program.ProgramObj);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, ldrTexture);
+    program.SetUniform("colorBuffer", 0);
+    glBindVertexArray(quadVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+    GL_CHECK_ERRORS;
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
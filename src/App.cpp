@@ -1,11 +1,20 @@
 #include "App.h"
+#include "CpuProfiler.h"
+#include "RenderStats.h"
 #include "Models/ImportScene.h"
+#include "Models/MeshOptimizer.h"
 #include "ShaderProgram.h"
 #include "Simulation/Cloth.h"
+#include <limits>
+#include <chrono>
+#include <iomanip>
 #include <map>
+#include <random>
 #include <sstream>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
-App::App(const std::string& pathToConfig)
+App::App(const std::string& pathToConfig, const nlohmann::json& overrides)
     : sideSplit(2)
 {
     std::ifstream input(pathToConfig);
@@ -13,6 +22,25 @@ App::App(const std::string& pathToConfig)
         throw std::runtime_error("Failed to load config");
     }
     input >> config;
+    for (const auto& item : overrides.items()) {
+        config[item.key()] = item.value();
+    }
+    //nobody can close hidden window
+    if (config["headless"] && config["benchmarkFrames"] == 0 && !config["cameraPlayback"]) {
+        throw std::runtime_error("Headless mode needs number of frames (benchmarkFrames or --frames) or camera path");
+    }
+    //there are only 16 taps in Poisson disk
+    int shadowTaps = config["shadowTaps"];
+    if (shadowTaps != 4 && shadowTaps != 8 && shadowTaps != 16) {
+        throw std::runtime_error("shadowTaps must be 4, 8 or 16");
+    }
+    //cascades are filtered with PCF only
+    if (config["dirShadowFilter"] != "pcf") {
+        if (config["shadowCascades"] > 0) {
+            throw std::runtime_error("Shadow cascades need dirShadowFilter \"pcf\"");
+        }
+        dirShadowFilter = static_cast<int>(MomentShadowMap::FilterFromString(config["dirShadowFilter"]));
+    }
 
     //setup initial state
     state.lastX = static_cast<float>(config["width"]) / 2.0f;
@@ -42,9 +70,6 @@ App::App(const std::string& pathToConfig)
 
     //setup point light source for shadow mapping
     //TODO: move this to some separate method for scene setup
-    float aspect = static_cast<float>(pointShadowMapWidth) / static_cast<float>(pointShadowMapHeight);
-    nearPlane = 1.0f;
-    farPlane = 2000.0f;
     lightPos = std::vector<glm::vec3>(
         { glm::vec3(-619.532f, 155.27f, 144.924f),
             glm::vec3(485.423f, 163.438f, 142.195f),
@@ -53,16 +78,22 @@ App::App(const std::string& pathToConfig)
             glm::vec3(1261.95f, 750.0f, 530.08f),
             glm::vec3(1253.91f, 750.0f, -601.096f) });
     lightColors = std::vector<glm::vec3>(lightPos.size(), glm::vec3(1.0f));
-    glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), aspect, nearPlane, farPlane);
+    lightAttenuation = glm::vec3(1.0f, 0.0007f, 0.000004f);
+    //light is cut off where it falls below threshold,
+    //shadow maps reach the farthest radius, so window isn't squeezed into shorter range
+    float lightThreshold = config["lightThreshold"];
+    farPlane = 0.0f;
     for (std::uint32_t i = 0; i < lightPos.size(); ++i) {
-        std::vector<glm::mat4> transforms;
-        transforms.push_back(shadowProj * glm::lookAt(lightPos[i], lightPos[i] + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-        transforms.push_back(shadowProj * glm::lookAt(lightPos[i], lightPos[i] + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-        transforms.push_back(shadowProj * glm::lookAt(lightPos[i], lightPos[i] + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)));
-        transforms.push_back(shadowProj * glm::lookAt(lightPos[i], lightPos[i] + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0)));
-        transforms.push_back(shadowProj * glm::lookAt(lightPos[i], lightPos[i] + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0)));
-        transforms.push_back(shadowProj * glm::lookAt(lightPos[i], lightPos[i] + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
-        lightSpaceTransforms.push_back(transforms);
+        //ambient, diffuse and specular terms together
+        float intensity = 0.9f * std::max(lightColors[i].r, std::max(lightColors[i].g, lightColors[i].b)) + 0.8f;
+        float radius = LightClusters::EffectiveRadius(
+            intensity,
+            lightAttenuation.x,
+            lightAttenuation.y,
+            lightAttenuation.z,
+            lightThreshold);
+        lightRadii.push_back(radius);
+        farPlane = std::max(farPlane, radius);
     }
 }
 
@@ -73,6 +104,8 @@ int App::initGL() const
         std::cout << "Failed to initialize OpenGL context" << std::endl;
         return -1;
     }
+    //count submitted work of every frame
+    RenderStats::Install();
 
     std::cout << "Vendor: " << glGetString(GL_VENDOR) << std::endl;
     std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
@@ -93,6 +126,8 @@ int App::createWindow()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    //headless runs render to offscreen target, window only provides context
+    glfwWindowHint(GLFW_VISIBLE, config["headless"] ? GL_FALSE : GL_TRUE);
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
@@ -155,6 +190,12 @@ void App::OnKeyboardPressed(GLFWwindow* window, int key, int /* scancode */, int
         std::cout << "Camera postion: ";
         std::cout << state->camera.Position.x << "f, " << state->camera.Position.y << "f, " << state->camera.Position.z << 'f' << std::endl;
         std::cout << "yaw = " << state->camera.Yaw << ", pitch = " << state->camera.Pitch << std::endl;
+        state->addPathKey = true;
+        break;
+    case GLFW_KEY_R: //start or stop recording of camera path
+        if (action == GLFW_PRESS) {
+            state->toggleRecording = true;
+        }
         break;
     case GLFW_KEY_1: //default rendring
         if (action == GLFW_PRESS) {
@@ -170,6 +211,16 @@ void App::OnKeyboardPressed(GLFWwindow* window, int key, int /* scancode */, int
             }
         }
         break;
+    case GLFW_KEY_4: //next anti-aliasing mode
+        if (action == GLFW_PRESS) {
+            state->switchAntiAliasing = true;
+        }
+        break;
+    case GLFW_KEY_5: //print render stats
+        if (action == GLFW_PRESS) {
+            state->showRenderStats = !state->showRenderStats;
+        }
+        break;
     case GLFW_KEY_3: //normals
         if (action == GLFW_PRESS) {
             if (state->renderingMode == RenderingMode::NORMALS_COLOR) {
@@ -249,6 +300,7 @@ void App::doCameraMovement()
 
 void App::loadModels()
 {
+    PROFILE_SCOPE("loadModels");
     //Load sponza scene
     importSceneFromFile(
         std::string(config["dataPath"]) + "/sponza/sponza.obj",
@@ -264,15 +316,34 @@ void App::loadModels()
             scene[i]->isStatic = false;
         }
     }
-    scene = unifyStaticMeshes(
-        scene,
-        materials);
+    {
+        PROFILE_SCOPE("unifyStaticMeshes");
+        scene = unifyStaticMeshes(
+            scene,
+            materials,
+            config["shortIndices"]);
+    }
     for (std::uint32_t i = 0; i < scene.size(); ++i) {
         if (materials[scene[i]->matId].name == std::string("flagpole")) {
             scene[i]->isStatic = true;
         }
     }
 
+    //optimize final buffers once: static meshes are split into meshlets for culling,
+    //others are reordered as a whole, stats are of the order used for drawing
+    std::uint32_t numMeshlets = 0;
+    OptimizationStats stats;
+    for (auto& mesh : scene) {
+        if (mesh->isStatic) {
+            stats.Add(buildMeshlets(*mesh, config["meshletFaces"]));
+            numMeshlets += mesh->meshlets.size();
+        } else {
+            stats.Add(optimizeMesh(*mesh));
+        }
+    }
+    std::cout << "Meshlets: " << numMeshlets << ", ACMR " << stats.ACMRBefore() << " -> " << stats.ACMRAfter()
+              << " (" << stats.numFaces << " faces)" << std::endl;
+
     //separate meshes with and without face culling
     for (std::size_t i = 0; i < scene.size(); ++i) {
         uint32_t matId = scene[i]->matId;
@@ -283,13 +354,21 @@ void App::loadModels()
         }
     }
 
-    //add mesh for light source
+    //add mesh for light source (instanced for every point light)
     scene.push_back(createCube());
     lightIdx = scene.size() - 1;
     scene[lightIdx]->name = "lightCube";
+    std::vector<glm::mat4> lightModels;
+    for (std::size_t i = 0; i < lightPos.size(); ++i) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, lightPos[i]);
+        model = glm::scale(model, glm::vec3(10.0f));
+        lightModels.push_back(model);
+    }
+    scene[lightIdx]->SetInstances(lightModels);
 
     //compute scene bounding box
-    AABBOX sceneBBOX = scene[0]->GetAABBOX();
+    sceneBBOX = scene[0]->GetAABBOX();
     for (std::size_t i = 1; i < scene.size(); ++i) {
         AABBOX meshBBOX = scene[i]->GetAABBOX();
         sceneBBOX.min = glm::min(sceneBBOX.min, meshBBOX.min);
@@ -300,6 +379,37 @@ void App::loadModels()
     std::cout << "Min: " << sceneBBOX.min.x << ' ' << sceneBBOX.min.y << ' ' << sceneBBOX.min.z << std::endl;
     std::cout << "Max: " << sceneBBOX.max.x << ' ' << sceneBBOX.max.y << ' ' << sceneBBOX.max.z << std::endl;
     std::cout << std::endl;
+
+    //extra point lights without shadows scattered over lower part of the scene
+    //(with fixed seed to get the same lights every run)
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    float extraLightQuadratic = config["extraLightQuadratic"];
+    float lightThreshold = config["lightThreshold"];
+    std::uint32_t numExtraLights = config["extraLights"];
+    for (std::uint32_t i = 0; i < numExtraLights; ++i) {
+        ClusteredLight light;
+        glm::vec3 size = sceneBBOX.max - sceneBBOX.min;
+        light.position = sceneBBOX.min + glm::vec3(uniform(generator), 0.3f * uniform(generator), uniform(generator)) * size;
+        light.color = glm::vec3(uniform(generator), uniform(generator), uniform(generator));
+        light.color /= std::max(light.color.r, std::max(light.color.g, light.color.b));
+        //diffuse and specular terms together
+        light.quadratic = extraLightQuadratic;
+        light.radius = LightClusters::EffectiveRadius(2.0f, 1.0f, 0.0f, light.quadratic, lightThreshold);
+        extraLights.push_back(light);
+    }
+    std::cout << "Extra lights: " << extraLights.size() << std::endl;
+    std::cout << std::endl;
+}
+
+void App::setupShadowSampler(GLenum target)
+{
+    //texture() returns fraction of 2x2 texels that pass comparison with reference depth
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    GL_CHECK_ERRORS;
 }
 
 void App::setupShadowMapBuffer()
@@ -309,36 +419,25 @@ void App::setupShadowMapBuffer()
     glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
     GL_CHECK_ERRORS;
 
-    //generate textures for depth map (we need three for filtering - original, x-axis pass, y-axis pass)
-    //and attach it to framebuffer
-    shadowMapTextures = std::vector<GLuint>(2);
-    for (std::uint32_t i = 0; i < 2; ++i) {
-        glGenTextures(1, &shadowMapTextures[i]);
-        GL_CHECK_ERRORS;
-        glBindTexture(GL_TEXTURE_2D, shadowMapTextures[i]);
-        GL_CHECK_ERRORS;
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, shadowMapWidth, shadowMapHeight, 0, GL_RG, GL_FLOAT, nullptr);
-        GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        GL_CHECK_ERRORS;
-    }
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowMapTextures[0], 0);
+    //only depth is rendered, it's sampled with hardware comparison for PCF
+    //or turned into moments by MomentShadowMap
+    glGenTextures(1, &shadowMapDepthTexture);
     GL_CHECK_ERRORS;
-
-    glGenRenderbuffers(1, &shadowMapRBO);
+    glBindTexture(GL_TEXTURE_2D, shadowMapDepthTexture);
     GL_CHECK_ERRORS;
-    glBindRenderbuffer(GL_RENDERBUFFER, shadowMapRBO);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, shadowMapWidth, shadowMapHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
     GL_CHECK_ERRORS;
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32, shadowMapWidth, shadowMapHeight);
+    setupShadowSampler(GL_TEXTURE_2D);
+    //everything outside of shadow map is lit
+    static const float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     GL_CHECK_ERRORS;
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, shadowMapRBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMapDepthTexture, 0);
     GL_CHECK_ERRORS;
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         throw std::runtime_error("Couldn't create framebuffer");
@@ -346,26 +445,46 @@ void App::setupShadowMapBuffer()
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     GL_CHECK_ERRORS;
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
     GL_CHECK_ERRORS;
 }
 
 void App::deleteShadowMapBuffer()
 {
-    glDeleteTextures(2, shadowMapTextures.data());
-    GL_CHECK_ERRORS;
-    glDeleteRenderbuffers(1, &shadowMapRBO);
+    glDeleteTextures(1, &shadowMapDepthTexture);
     GL_CHECK_ERRORS;
     glDeleteFramebuffers(1, &shadowMapFBO);
     GL_CHECK_ERRORS;
 }
 
-void App::renderShadowMap(ShaderProgram& depthProgram, ShaderProgram& quadDepthProgram)
+void App::renderShadowMap(ShaderProgram& depthProgram, ShaderProgram& momentsProgram)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+    if (shadowCascades.GetNumCascades() > 0) {
+        //only cascades scheduled for this frame, casters are culled by each cascade
+        float ratio = static_cast<float>(config["width"]) / static_cast<float>(config["height"]);
+        std::vector<int> cascades = shadowCascades.Update(
+            state.camera.GetViewMatrix(),
+            glm::radians(state.camera.Zoom),
+            ratio,
+            1.0f,
+            config["shadowDistance"],
+            lightDir,
+            sceneBBOX.min,
+            sceneBBOX.max);
+        glEnable(GL_DEPTH_TEST);
+        glUseProgram(depthProgram.ProgramObj); //StartUseShader
+        for (int cascade : cascades) {
+            shadowCascades.BeginCascade(cascade);
+            depthProgram.SetUniform("lightSpaceMatrix", shadowCascades.GetMatrix(cascade));
+            CullingView view;
+            view.frustum = Frustum(shadowCascades.GetMatrix(cascade));
+            drawMeshes(shadowCasters, &view);
+        }
+        glUseProgram(0); //StoptUseShader
+        return;
+    }
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowMapTextures[0], 0);
-    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
 
     glEnable(GL_DEPTH_TEST);
 
@@ -375,67 +494,21 @@ void App::renderShadowMap(ShaderProgram& depthProgram, ShaderProgram& quadDepthP
     glUseProgram(depthProgram.ProgramObj); //StartUseShader
 
     depthProgram.SetUniform("lightSpaceMatrix", lightSpaceMatrix);
-    for (std::size_t i = 0; i < scene.size(); ++i) {
-        if (duplicatedModels.count(i)) {
-            //TODO: use instancing here
-            for (auto& model : duplicatedModels[i]) {
-                depthProgram.SetUniform("model", model);
-                scene[i]->Draw();
-            }
-        } else {
-            depthProgram.SetUniform("model", scene[i]->model);
-            scene[i]->Draw();
-        }
-    }
-
-    //smooth using gaussian filter
-    glUseProgram(quadDepthProgram.ProgramObj); //StartUseShader
-
-    //x-direction
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowMapTextures[1], 0);
-    GL_CHECK_ERRORS;
-
-    glDisable(GL_DEPTH_TEST);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, shadowMapTextures[0]);
-    quadDepthProgram.SetUniform("shadowMap", 0);
-    quadDepthProgram.SetUniform("gaussFilter", true);
-    quadDepthProgram.SetUniform("direction", true);
-
-    glBindVertexArray(quadVAO);
-    GL_CHECK_ERRORS;
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-    GL_CHECK_ERRORS;
-    glBindVertexArray(0);
-    GL_CHECK_ERRORS;
-
-    //y-direction
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowMapTextures[0], 0);
-    GL_CHECK_ERRORS;
-
-    glDisable(GL_DEPTH_TEST);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, shadowMapTextures[1]);
-    quadDepthProgram.SetUniform("shadowMap", 0);
-    quadDepthProgram.SetUniform("gaussFilter", true);
-    quadDepthProgram.SetUniform("direction", false);
-
-    glBindVertexArray(quadVAO);
-    GL_CHECK_ERRORS;
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-    GL_CHECK_ERRORS;
-    glBindVertexArray(0);
-    GL_CHECK_ERRORS;
+    CullingView view;
+    view.frustum = Frustum(lightSpaceMatrix);
+    drawMeshes(shadowCasters, &view);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
     glUseProgram(0); //StoptUseShader
+
+    //PCF uses depth directly
+    if (dirShadowFilter != 0) {
+        momentShadowMap.Build(shadowMapDepthTexture, momentsProgram, quadVAO);
+    }
 }
 
 void App::visualizeShadowMap(ShaderProgram& quadDepthProgram)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
 
     glDisable(GL_DEPTH_TEST);
 
@@ -443,108 +516,91 @@ void App::visualizeShadowMap(ShaderProgram& quadDepthProgram)
 
     glUseProgram(quadDepthProgram.ProgramObj); //StartUseShader
 
-    //set color bufer texture
+    //depth is shown without comparison, single shadow map isn't rendered if there are cascades
+    int numCascades = shadowCascades.GetNumCascades();
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, shadowMapTextures[0]);
+    glBindTexture(GL_TEXTURE_2D, shadowMapDepthTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
     quadDepthProgram.SetUniform("shadowMap", 0);
-
-    quadDepthProgram.SetUniform("gaussFilter", false);
-    quadDepthProgram.SetUniform("direction", true);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, numCascades > 0 ? shadowCascades.GetDepthTexture() : 0);
+    if (numCascades > 0) {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    }
+    quadDepthProgram.SetUniform("cascadeMap", 1);
+    quadDepthProgram.SetUniform("numCascades", numCascades);
 
     glBindVertexArray(quadVAO);
     GL_CHECK_ERRORS;
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
     GL_CHECK_ERRORS;
     glBindVertexArray(0);
     GL_CHECK_ERRORS;
 
+    if (numCascades > 0) {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
     glBindTexture(GL_TEXTURE_2D, 0);
     glUseProgram(0); //StopUseShader
 }
 
-void App::setupPointShadowMapBuffer()
+void App::renderPointShadowMap(ShaderProgram& depthProgram, const Frustum& cameraFrustum)
 {
-    glGenFramebuffers(1, &pointShadowMapFBO);
-    GL_CHECK_ERRORS;
-    glBindFramebuffer(GL_FRAMEBUFFER, pointShadowMapFBO);
-    GL_CHECK_ERRORS;
-
-    //create cubemap texture
-    pointShadowMapTextures.resize(lightPos.size());
-    for (std::uint32_t i = 0; i < lightPos.size(); ++i) {
-        glGenTextures(1, &pointShadowMapTextures[i]);
-        GL_CHECK_ERRORS;
-        glBindTexture(GL_TEXTURE_CUBE_MAP, pointShadowMapTextures[i]);
-        for (std::uint32_t j = 0; j < 6; ++j) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + j, 0, GL_DEPTH_COMPONENT,
-                pointShadowMapWidth, pointShadowMapHeight, 0,
-                GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    //bounding spheres of moving objects, faces that see them are rendered every frame
+    std::vector<glm::vec4> dynamicCasters;
+    for (std::size_t i : shadowCasters) {
+        const auto& mesh = scene[i];
+        if (mesh->isStatic) {
+            continue;
+        }
+        AABBOX bbox = mesh->GetAABBOX(false);
+        glm::vec3 center = (bbox.min + bbox.max) / 2.0f;
+        float radius = glm::length(bbox.max - bbox.min) / 2.0f;
+        std::vector<glm::mat4> models = mesh->instanceModels.empty()
+            ? std::vector<glm::mat4>({ mesh->model })
+            : mesh->instanceModels;
+        for (const auto& model : models) {
+            float scale = std::max(
+                glm::length(glm::vec3(model[0])),
+                std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            dynamicCasters.push_back(glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale));
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        GL_CHECK_ERRORS;
     }
-
-    //attach texture to framebuffer
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pointShadowMapTextures[0], 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        throw std::runtime_error("Couldn't create framebuffer");
+    std::vector<ShadowFace> faces = shadowAtlas.Update(
+        lightPos,
+        lightRadii,
+        cameraFrustum,
+        state.camera.Position,
+        glm::radians(state.camera.Zoom),
+        config["height"],
+        dynamicCasters,
+        config["shadowFaceBudget"]);
+    if (faces.empty()) {
+        return;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    GL_CHECK_ERRORS;
-}
-
-void App::deletePointShadowMapBuffer()
-{
-    glDeleteTextures(lightPos.size(), pointShadowMapTextures.data());
-    glDeleteFramebuffers(1, &pointShadowMapFBO);
-    GL_CHECK_ERRORS;
-}
-
-void App::renderPointShadowMap(ShaderProgram& depthProgram)
-{
-    glBindFramebuffer(GL_FRAMEBUFFER, pointShadowMapFBO);
-
-    for (std::uint32_t i = 0; i < lightPos.size(); ++i) {
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pointShadowMapTextures[i], 0);
-
-        glEnable(GL_DEPTH_TEST);
-
-        glViewport(0, 0, pointShadowMapWidth, pointShadowMapHeight);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        glUseProgram(depthProgram.ProgramObj); //StartUseShader
-
-        for (std::uint32_t j = 0; j < lightSpaceTransforms[i].size(); ++j) {
-            depthProgram.SetUniform(
-                "lightSpaceTransforms[" + std::to_string(j) + "]",
-                lightSpaceTransforms[i][j]);
-        }
-        depthProgram.SetUniform("lightPos", lightPos[i]);
-        depthProgram.SetUniform("farPlane", farPlane);
-
-        for (std::size_t j = 0; j < scene.size(); ++j) {
-            if (duplicatedModels.count(j)) {
-                //TODO: use instancing here
-                for (auto& model : duplicatedModels[j]) {
-                    depthProgram.SetUniform("model", model);
-                    scene[j]->Draw();
-                }
-            } else {
-                depthProgram.SetUniform("model", scene[j]->model);
-                scene[j]->Draw();
-            }
-        }
-
-        glUseProgram(0); //StopUseShader
+    glEnable(GL_DEPTH_TEST);
+    glUseProgram(depthProgram.ProgramObj); //StartUseShader
+    depthProgram.SetUniform("farPlane", farPlane);
+    for (const auto& face : faces) {
+        gpuProfiler.BeginZone("light " + std::to_string(face.light));
+        shadowAtlas.BeginFace(face);
+        glm::mat4 faceMatrix = shadowAtlas.GetFaceMatrix(face);
+        depthProgram.SetUniform("lightSpaceMatrix", faceMatrix);
+        depthProgram.SetUniform("lightPos", lightPos[face.light]);
+
+        //casters beyond light radius are clipped by far plane of face
+        CullingView view;
+        view.frustum = Frustum(faceMatrix);
+        view.position = lightPos[face.light];
+        drawMeshes(shadowCasters, &view);
+        gpuProfiler.EndZone();
     }
+    shadowAtlas.End();
+    glUseProgram(0); //StopUseShader
 }
 
 //TODO: Move this to Mesh.cpp
@@ -556,7 +612,7 @@ void App::setupQuad()
         1.0f, 1.0f, 1.0f, 1.0f,
         -1.0f, 1.0f, 0.0f, 1.0f
     };
-    uint32_t indices[6] = {
+    uint16_t indices[6] = {
         0, 2, 3,
         2, 0, 1
     };
@@ -586,7 +642,7 @@ void App::setupQuad()
     //indices
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
     GL_CHECK_ERRORS;
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint16_t), indices, GL_STATIC_DRAW);
     GL_CHECK_ERRORS;
     //unbind VAO and VBO
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -604,6 +660,11 @@ void App::deleteQuad()
 
 void App::setupColorBuffer()
 {
+    //MSAA renders to multisampled targets resolved by blit,
+    //post-processing anti-aliasing reads single sample targets (and depth for TAA) directly
+    int samples = antiAliasing.GetSamples();
+    GLenum target = samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+
     glGenFramebuffers(1, &colorBufferFBO);
     GL_CHECK_ERRORS;
     glBindFramebuffer(GL_FRAMEBUFFER, colorBufferFBO);
@@ -615,303 +676,650 @@ void App::setupColorBuffer()
     for (std::uint32_t i = 0; i < 2; ++i) {
         glGenTextures(1, &colorBufferTextures[i]);
         GL_CHECK_ERRORS;
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, colorBufferTextures[i]);
+        glBindTexture(target, colorBufferTextures[i]);
         GL_CHECK_ERRORS;
-        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB16F, config["width"], config["height"], GL_TRUE);
+        if (samples > 1) {
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_RGB16F, config["width"], config["height"], GL_TRUE);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, config["width"], config["height"], 0, GL_RGB, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
         GL_CHECK_ERRORS;
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D_MULTISAMPLE, colorBufferTextures[i], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, target, colorBufferTextures[i], 0);
         GL_CHECK_ERRORS;
     }
     GLuint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
     glDrawBuffers(2, attachments);
     glReadBuffer(GL_COLOR_ATTACHMENT1);
 
-    //create renderbuffer for depth and stencil buffers and attach it to the framebuffer
-    glGenRenderbuffers(1, &colorBufferRBO);
-    GL_CHECK_ERRORS;
-    glBindRenderbuffer(GL_RENDERBUFFER, colorBufferRBO);
-    GL_CHECK_ERRORS;
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, config["width"], config["height"]);
-    GL_CHECK_ERRORS;
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, colorBufferRBO);
-    GL_CHECK_ERRORS;
+    if (samples > 1) {
+        //create renderbuffer for depth and stencil buffers and attach it to the framebuffer
+        glGenRenderbuffers(1, &colorBufferRBO);
+        GL_CHECK_ERRORS;
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBufferRBO);
+        GL_CHECK_ERRORS;
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, config["width"], config["height"]);
+        GL_CHECK_ERRORS;
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, colorBufferRBO);
+        GL_CHECK_ERRORS;
+    } else {
+        //depth is sampled by TAA to reproject history
+        glGenTextures(1, &colorBufferDepthTexture);
+        GL_CHECK_ERRORS;
+        glBindTexture(GL_TEXTURE_2D, colorBufferDepthTexture);
+        GL_CHECK_ERRORS;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, config["width"], config["height"], 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        GL_CHECK_ERRORS;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, colorBufferDepthTexture, 0);
+        GL_CHECK_ERRORS;
+    }
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         throw std::runtime_error("Couldn't create framebuffer");
     }
 
-    glGenFramebuffers(1, &pongFBO);
-    GL_CHECK_ERRORS;
-    glBindFramebuffer(GL_FRAMEBUFFER, pongFBO);
-    GL_CHECK_ERRORS;
-
-    //generate textures for depth map (we need three for filtering - original, x-axis pass, y-axis pass)
-    //and attach it to framebuffer
-    pongTextures = std::vector<GLuint>(2);
-    for (std::uint32_t i = 0; i < 2; ++i) {
-        glGenTextures(1, &pongTextures[i]);
+    if (samples > 1) {
+        //resolve targets of multisampled color
+        glGenFramebuffers(1, &pongFBO);
         GL_CHECK_ERRORS;
-        glBindTexture(GL_TEXTURE_2D, pongTextures[i]);
+        glBindFramebuffer(GL_FRAMEBUFFER, pongFBO);
         GL_CHECK_ERRORS;
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, config["width"], config["height"], 0, GL_RGB, GL_FLOAT, nullptr);
+
+        pongTextures = std::vector<GLuint>(2);
+        for (std::uint32_t i = 0; i < 2; ++i) {
+            glGenTextures(1, &pongTextures[i]);
+            GL_CHECK_ERRORS;
+            glBindTexture(GL_TEXTURE_2D, pongTextures[i]);
+            GL_CHECK_ERRORS;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, config["width"], config["height"], 0, GL_RGB, GL_FLOAT, nullptr);
+            GL_CHECK_ERRORS;
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            GL_CHECK_ERRORS;
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+            GL_CHECK_ERRORS;
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            GL_CHECK_ERRORS;
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            GL_CHECK_ERRORS;
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[0], 0);
         GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            throw std::runtime_error("Couldn't create framebuffer");
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GL_CHECK_ERRORS;
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void App::deleteColorBuffer()
+{
+    glDeleteTextures(colorBufferTextures.size(), colorBufferTextures.data());
+    GL_CHECK_ERRORS;
+    glDeleteFramebuffers(1, &colorBufferFBO);
+    GL_CHECK_ERRORS;
+    if (antiAliasing.GetSamples() > 1) {
+        glDeleteRenderbuffers(1, &colorBufferRBO);
         GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glDeleteTextures(pongTextures.size(), pongTextures.data());
         GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glDeleteFramebuffers(1, &pongFBO);
         GL_CHECK_ERRORS;
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    } else {
+        glDeleteTextures(1, &colorBufferDepthTexture);
         GL_CHECK_ERRORS;
     }
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[0], 0);
-    GL_CHECK_ERRORS;
+}
 
-    glGenRenderbuffers(1, &pongRBO);
-    GL_CHECK_ERRORS;
-    glBindRenderbuffer(GL_RENDERBUFFER, pongRBO);
-    GL_CHECK_ERRORS;
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32, config["width"], config["height"]);
+void App::setupGBuffer()
+{
+    glGenFramebuffers(1, &gBufferFBO);
     GL_CHECK_ERRORS;
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pongRBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
     GL_CHECK_ERRORS;
 
+    //albedo, normal, specular and depth, all sampled with texelFetch in lighting pass
+    std::vector<GLenum> internalFormats = { GL_RGBA8, GL_RG16, GL_RGBA8, GL_DEPTH24_STENCIL8 };
+    std::vector<GLenum> formats = { GL_RGBA, GL_RG, GL_RGBA, GL_DEPTH_STENCIL };
+    std::vector<GLenum> types = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE, GL_UNSIGNED_INT_24_8 };
+    gBufferTextures = std::vector<GLuint>(internalFormats.size());
+    glGenTextures(gBufferTextures.size(), gBufferTextures.data());
+    GL_CHECK_ERRORS;
+    for (std::uint32_t i = 0; i < gBufferTextures.size(); ++i) {
+        glBindTexture(GL_TEXTURE_2D, gBufferTextures[i]);
+        GL_CHECK_ERRORS;
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], config["width"], config["height"], 0, formats[i], types[i], NULL);
+        GL_CHECK_ERRORS;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        GL_CHECK_ERRORS;
+        GLenum attachment = i + 1 < gBufferTextures.size() ? GL_COLOR_ATTACHMENT0 + i : GL_DEPTH_STENCIL_ATTACHMENT;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, gBufferTextures[i], 0);
+        GL_CHECK_ERRORS;
+    }
+    GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, attachments);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        throw std::runtime_error("Couldn't create framebuffer");
+        throw std::runtime_error("Couldn't create G-buffer");
     }
-
+    glBindTexture(GL_TEXTURE_2D, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void App::deleteGBuffer()
+{
+    glDeleteTextures(gBufferTextures.size(), gBufferTextures.data());
     GL_CHECK_ERRORS;
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glDeleteFramebuffers(1, &gBufferFBO);
     GL_CHECK_ERRORS;
 }
 
-void App::deleteColorBuffer()
+void App::setupOutputBuffer()
 {
-    glDeleteTextures(colorBufferTextures.size(), colorBufferTextures.data());
+    //pixels of hidden window may be discarded, so headless image is kept in texture
+    if (!config["headless"]) {
+        outputFBO = 0;
+        return;
+    }
+    glGenTextures(1, &outputTexture);
     GL_CHECK_ERRORS;
-    glDeleteRenderbuffers(1, &colorBufferRBO);
+    glBindTexture(GL_TEXTURE_2D, outputTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, config["width"], config["height"], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     GL_CHECK_ERRORS;
-    glDeleteFramebuffers(1, &colorBufferFBO);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &outputFBO);
     GL_CHECK_ERRORS;
-    glDeleteTextures(pongTextures.size(), pongTextures.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outputTexture, 0);
     GL_CHECK_ERRORS;
-    glDeleteFramebuffers(1, &pongRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create output framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void App::deleteOutputBuffer()
+{
+    if (outputFBO == 0) {
+        return;
+    }
+    glDeleteTextures(1, &outputTexture);
     GL_CHECK_ERRORS;
-    glDeleteFramebuffers(1, &pongFBO);
+    glDeleteFramebuffers(1, &outputFBO);
     GL_CHECK_ERRORS;
+    outputFBO = 0;
+}
+
+void App::dumpFrame(std::uint64_t frame)
+{
+    std::uint32_t width = config["width"];
+    std::uint32_t height = config["height"];
+    std::vector<unsigned char> pixels(width * height * 3);
+    //synchronous readback, it stalls pipeline, so dumps slow down measured frames
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFBO);
+    glReadBuffer(outputFBO == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    std::ostringstream path;
+    path << std::string(config["dumpFrames"]) << "/frame_" << std::setw(6) << std::setfill('0') << frame << ".png";
+    //OpenGL rows go from bottom to top
+    stbi_flip_vertically_on_write(1);
+    if (!stbi_write_png(path.str().c_str(), width, height, 3, pixels.data(), width * 3)) {
+        throw std::runtime_error("Failed to write " + path.str());
+    }
+}
+
+void App::drawMeshes(const std::vector<std::size_t>& meshIdx, const CullingView* view)
+{
+    //meshes from shared static buffer are drawn with one call, others one by one
+    std::vector<std::size_t> buffered;
+    for (std::size_t i : meshIdx) {
+        if (staticMeshBuffer.Contains(i)) {
+            buffered.push_back(i);
+        } else {
+            scene[i]->Draw();
+        }
+    }
+    staticMeshBuffer.Draw(buffered, view);
+}
+
+namespace {
+const char* passName(RenderPass pass)
+{
+    switch (pass) {
+    case RenderPass::DEPTH_PREPASS:
+        return "depth prepass";
+    case RenderPass::GBUFFER_PASS:
+        return "gbuffer";
+    case RenderPass::LIGHTING_PASS:
+        return "lighting";
+    default:
+        return "light sources";
+    }
+}
+}
+
+void App::submitRenderQueue(const std::vector<ShaderProgram*>& programs, const CullingView& view)
+{
+    //track current state to skip redundant program, face culling and material changes
+    //meshes between state changes are drawn together
+    std::vector<std::size_t> batch;
+    CullingView batchView = view;
+    int currentPass = -1;
+    std::uint32_t currentProgram = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t currentMaterial = std::numeric_limits<std::uint32_t>::max();
+    int currentCullMode = -1;
+    for (std::uint64_t key : renderQueue.GetKeys()) {
+        RenderPass pass = RenderKey::GetPass(key);
+        std::uint32_t program = RenderKey::GetProgram(key);
+        CullMode cullMode = RenderKey::GetCullMode(key);
+        //opaque depth pre-pass doesn't read material at all
+        bool depthPass = pass == RenderPass::DEPTH_PREPASS;
+        bool hasMaterial = pass != RenderPass::LIGHT_SOURCES_PASS && program != RenderProgram::DEPTH_PROGRAM;
+        std::uint32_t matId = RenderKey::GetMaterial(key);
+        if (pass != currentPass
+            || program != currentProgram
+            || cullMode != currentCullMode
+            || (hasMaterial && matId != currentMaterial)) {
+            drawMeshes(batch, &batchView);
+            batch.clear();
+        }
+        if (pass != currentPass) {
+            if (currentPass != -1) {
+                gpuProfiler.EndZone();
+            }
+            gpuProfiler.BeginZone(passName(pass));
+            RenderStats::SetPass(passName(pass));
+            setupRenderPass(pass);
+            currentPass = pass;
+            //meshlets are culled the same way in every pass, count them once
+            bool shadingPass = pass == RenderPass::GBUFFER_PASS || pass == RenderPass::LIGHTING_PASS;
+            batchView.stats = shadingPass ? view.stats : nullptr;
+        }
+        if (program != currentProgram) {
+            glUseProgram(programs[program]->ProgramObj);
+            currentProgram = program;
+            //material uniforms are per program
+            currentMaterial = std::numeric_limits<std::uint32_t>::max();
+        }
+        if (cullMode != currentCullMode) {
+            if (cullMode == CullMode::CULL_NONE) {
+                glDisable(GL_CULL_FACE);
+            } else {
+                glEnable(GL_CULL_FACE);
+            }
+            currentCullMode = cullMode;
+            //meshlets facing away can be skipped only if back faces are culled anyway
+            batchView.cullBackfacing = cullMode == CullMode::CULL_BACK;
+        }
+        if (hasMaterial && matId != currentMaterial && depthPass) {
+            materials[matId].SetupAlphaTest(*programs[program], textures, GL_TEXTURE0, 0);
+            currentMaterial = matId;
+        } else if (hasMaterial && matId != currentMaterial) {
+            materials[matId].Setup(
+                *programs[program],
+                textures,
+                GL_TEXTURE0,
+                GL_TEXTURE1,
+                GL_TEXTURE2,
+                0,
+                1,
+                2);
+            currentMaterial = matId;
+        }
+        batch.push_back(RenderKey::GetMesh(key));
+    }
+    drawMeshes(batch, &batchView);
+    if (currentPass != -1) {
+        gpuProfiler.EndZone();
+    }
+}
+
+glm::mat4 App::getProjection() const
+{
+    float ratio = static_cast<float>(config["width"]) / static_cast<float>(config["height"]);
+    return glm::perspective(glm::radians(state.camera.Zoom), ratio, 1.0f, 3000.0f);
+}
+
+void App::setupRenderPass(RenderPass pass)
+{
+    if (pass == RenderPass::DEPTH_PREPASS) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    } else if ((pass == RenderPass::GBUFFER_PASS || pass == RenderPass::LIGHTING_PASS) && config["depthPrePass"]) {
+        //depth is already filled, shade only fragments that won
+        //(depth writes are off, so discard in shader doesn't prevent early depth test)
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_EQUAL);
+    } else {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+}
+
+void App::setupLights(ShaderProgram& program, const glm::mat4& view)
+{
+    //set spotlight source
+    program.SetUniform("spotlightOn", state.isFlashlightOn);
+    program.SetUniform("spotLight.pointLight.position", glm::vec3(0.0f));
+    program.SetUniform("spotLight.pointLight.ambient", glm::vec3(0.05f));
+    program.SetUniform("spotLight.pointLight.diffuse", glm::vec3(0.9f));
+    program.SetUniform("spotLight.pointLight.specular", glm::vec3(1.0f));
+    program.SetUniform("spotLight.pointLight.constant", 1.0f);
+    program.SetUniform("spotLight.pointLight.linear", 0.0014f);
+    program.SetUniform("spotLight.pointLight.quadratic", 0.000007f);
+    program.SetUniform("spotLight.direction", glm::vec3(0.0f, 0.0f, -1.0f));
+    program.SetUniform("spotLight.cutOff", glm::cos(glm::radians(15.0f)));
+    program.SetUniform("spotLight.outerCutOff", glm::cos(glm::radians(20.0f)));
+
+    //set directional light source
+    glm::vec4 direction = glm::vec4(lightDir, 0.0f);
+    program.SetUniform("dirLight.direction", glm::vec3(view * direction));
+    program.SetUniform("dirLight.ambient", glm::vec3(0.3f));
+    program.SetUniform("dirLight.diffuse", glm::vec3(0.9f));
+    program.SetUniform("dirLight.specular", glm::vec3(0.9f));
+    momentShadowMap.Bind(program, 3);
+    glActiveTexture(GL_TEXTURE11);
+    glBindTexture(GL_TEXTURE_2D, shadowMapDepthTexture);
+    program.SetUniform("dirLight.shadowMapDepth", 11);
+    program.SetUniform("dirLight.shadowFilter", dirShadowFilter);
+    program.SetUniform("shadowTaps", static_cast<int>(config["shadowTaps"]));
+    shadowCascades.Bind(program, 12);
+    shadowAtlas.Bind(program, 4);
+    program.SetUniform("lightSpaceMatrix", lightSpaceMatrix);
+
+    //lists of lights per cluster
+    lightClusters.Bind(program, 14, 15);
+    program.SetUniform("screenSize", glm::vec2(dynamicResolution.GetRenderSize()));
+
+    //set light sources
+    program.SetUniform("farPlane", farPlane);
+    for (std::uint32_t i = 0; i < lightPos.size(); ++i) {
+        std::string idx = std::to_string(i);
+        //set point light source
+        glm::vec4 lightPosView = view * glm::vec4(lightPos[i], 1.0f);
+        program.SetUniform("pointLights[" + idx + "].position", glm::vec3(lightPosView));
+        program.SetUniform("pointLights[" + idx + "].positionWorldSpace", lightPos[i]);
+        program.SetUniform("pointLights[" + idx + "].ambient", 0.1f * lightColors[i]);
+        program.SetUniform("pointLights[" + idx + "].diffuse", 0.8f * lightColors[i]);
+        program.SetUniform("pointLights[" + idx + "].specular", glm::vec3(0.8f));
+        program.SetUniform("pointLights[" + idx + "].constant", lightAttenuation.x);
+        program.SetUniform("pointLights[" + idx + "].linear", lightAttenuation.y);
+        program.SetUniform("pointLights[" + idx + "].quadratic", lightAttenuation.z);
+        program.SetUniform("pointLights[" + idx + "].radius", lightRadii[i]);
+    }
 }
 
 void App::renderScene(
     ShaderProgram& lightningProgram,
     ShaderProgram& sourceProgram,
-    ShaderProgram& quadColorProgram)
+    ShaderProgram& bloomProgram,
+    ShaderProgram& hiZProgram,
+    ShaderProgram& depthProgram,
+    ShaderProgram& depthAlphaProgram,
+    ShaderProgram& gBufferProgram,
+    ShaderProgram& deferredProgram,
+    ShaderProgram& taaProgram)
 {
+    PROFILE_SCOPE("renderScene");
     glBindFramebuffer(GL_FRAMEBUFFER, colorBufferFBO);
 
     glEnable(GL_DEPTH_TEST);
 
+    //scene is rendered to lower left part of color buffer, it's upscaled in visualizeScene
+    glm::ivec2 renderSize = dynamicResolution.GetRenderSize();
+    glm::vec2 uvScale = dynamicResolution.GetUVScale();
+    if (renderSize != lastRenderSize) {
+        antiAliasing.ResetHistory();
+        lastRenderSize = renderSize;
+    }
+
     //clear screen and then fill it with color
-    glViewport(0, 0, config["width"], config["height"]);
+    glViewport(0, 0, renderSize.x, renderSize.y);
     static const float color0[] = { 0.53f, 0.81f, 0.92f, 1.0f };
     glClearBufferfv(GL_COLOR, 0, color0);
     static const float color1[] = { 0.0f, 0.0f, 0.0f, 1.0f };
     glClearBufferfv(GL_COLOR, 1, color1);
     glClear(GL_DEPTH_BUFFER_BIT);
 
-    glUseProgram(lightningProgram.ProgramObj); //StartUseShader
-
     //view
     glm::mat4 view = state.camera.GetViewMatrix();
     //projection
     float ratio = static_cast<float>(config["width"]) / static_cast<float>(config["height"]);
-    glm::mat4 projection = glm::perspective(glm::radians(state.camera.Zoom), ratio, 1.0f, 3000.0f);
+    glm::mat4 unjitteredProjection = getProjection();
+    //TAA moves image by subpixel offset every frame
+    glm::mat4 projection = antiAliasing.JitterProjection(unjitteredProjection, renderSize);
 
-    lightningProgram.SetUniform("visualizeNormalsWithColor", state.renderingMode == RenderingMode::NORMALS_COLOR);
+    //forward path shades meshes directly, deferred one writes G-buffer and shades it with fullscreen quad
+    bool deferred = config["renderingPath"] == "deferred";
+    ShaderProgram& surfaceProgram = deferred ? gBufferProgram : lightningProgram;
+    ShaderProgram& shadingProgram = deferred ? deferredProgram : lightningProgram;
 
-    //set spotlight source
-    lightningProgram.SetUniform("spotlightOn", state.isFlashlightOn);
-    lightningProgram.SetUniform("spotLight.pointLight.position", glm::vec3(0.0f));
-    lightningProgram.SetUniform("spotLight.pointLight.ambient", glm::vec3(0.05f));
-    lightningProgram.SetUniform("spotLight.pointLight.diffuse", glm::vec3(0.9f));
-    lightningProgram.SetUniform("spotLight.pointLight.specular", glm::vec3(1.0f));
-    lightningProgram.SetUniform("spotLight.pointLight.constant", 1.0f);
-    lightningProgram.SetUniform("spotLight.pointLight.linear", 0.0014f);
-    lightningProgram.SetUniform("spotLight.pointLight.quadratic", 0.000007f);
-    lightningProgram.SetUniform("spotLight.direction", glm::vec3(0.0f, 0.0f, -1.0f));
-    lightningProgram.SetUniform("spotLight.cutOff", glm::cos(glm::radians(15.0f)));
-    lightningProgram.SetUniform("spotLight.outerCutOff", glm::cos(glm::radians(20.0f)));
+    //assign lights to clusters
+    std::vector<ClusteredLight> shadowedLights(lightPos.size());
+    for (std::size_t i = 0; i < lightPos.size(); ++i) {
+        shadowedLights[i].position = lightPos[i];
+        shadowedLights[i].color = lightColors[i];
+        shadowedLights[i].radius = lightRadii[i];
+    }
+    lightClusters.Update(view, glm::radians(state.camera.Zoom), ratio, 1.0f, 3000.0f, extraLights, shadowedLights);
+
+    {
+        PROFILE_SCOPE("uniform setup");
+        glUseProgram(shadingProgram.ProgramObj); //StartUseShader
+        shadingProgram.SetUniform("visualizeNormalsWithColor", state.renderingMode == RenderingMode::NORMALS_COLOR);
+        setupLights(shadingProgram, view);
+        if (deferred) {
+            shadingProgram.SetUniform("inverseProjection", glm::inverse(projection));
+            shadingProgram.SetUniform("inverseView", glm::inverse(view));
+        }
 
-    //set directional light source
-    glm::vec4 direction = glm::vec4(lightDir, 0.0f);
-    lightningProgram.SetUniform("dirLight.direction", glm::vec3(view * direction));
-    lightningProgram.SetUniform("dirLight.ambient", glm::vec3(0.3f));
-    lightningProgram.SetUniform("dirLight.diffuse", glm::vec3(0.9f));
-    lightningProgram.SetUniform("dirLight.specular", glm::vec3(0.9f));
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, shadowMapTextures[0]);
-    lightningProgram.SetUniform("dirLight.shadowMap", 3);
-
-    lightningProgram.SetUniform("view", view);
-    lightningProgram.SetUniform("projection", projection);
-    lightningProgram.SetUniform("lightSpaceMatrix", lightSpaceMatrix);
+        glUseProgram(surfaceProgram.ProgramObj);
+        surfaceProgram.SetUniform("view", view);
+        surfaceProgram.SetUniform("viewProjection", projection * view);
 
-    //set light sources
-    lightningProgram.SetUniform("farPlane", farPlane);
-    for (std::uint32_t i = 0; i < lightPos.size(); ++i) {
-        std::string idx = std::to_string(i);
-        //set point light source
-        glm::vec4 lightPosView = view * glm::vec4(lightPos[i], 1.0f);
-        lightningProgram.SetUniform("pointLights[" + idx + "].position", glm::vec3(lightPosView));
-        lightningProgram.SetUniform("pointLights[" + idx + "].positionWorldSpace", lightPos[i]);
-        lightningProgram.SetUniform("pointLights[" + idx + "].ambient", 0.1f * lightColors[i]);
-        lightningProgram.SetUniform("pointLights[" + idx + "].diffuse", 0.8f * lightColors[i]);
-        lightningProgram.SetUniform("pointLights[" + idx + "].specular", glm::vec3(0.8f));
-        lightningProgram.SetUniform("pointLights[" + idx + "].constant", 1.0f);
-        lightningProgram.SetUniform("pointLights[" + idx + "].linear", 0.0007f);
-        lightningProgram.SetUniform("pointLights[" + idx + "].quadratic", 0.000004f);
-        glActiveTexture(GL_TEXTURE0 + i + 4);
-        GL_CHECK_ERRORS;
-        glBindTexture(GL_TEXTURE_CUBE_MAP, pointShadowMapTextures[i]);
-        GL_CHECK_ERRORS;
-        lightningProgram.SetUniform("pointLights[" + idx + "].pointShadowMap", static_cast<int>(4 + i));
-        GL_CHECK_ERRORS;
+        //light sources (one instance of light cube per source)
+        glUseProgram(sourceProgram.ProgramObj); //StartUseShader
+        sourceProgram.SetUniform("view", view);
+        sourceProgram.SetUniform("projection", projection);
+        for (std::size_t i = 0; i < lightPos.size(); ++i) {
+            sourceProgram.SetUniform("lightColors[" + std::to_string(i) + "]", lightColors[i] + glm::vec3(0.1));
+        }
+    }
+
+    //depth pre-pass uses the same transform as lighting pass
+    bool depthPrePass = config["depthPrePass"];
+    if (depthPrePass) {
+        glUseProgram(depthProgram.ProgramObj);
+        depthProgram.SetUniform("lightSpaceMatrix", projection * view);
+        glUseProgram(depthAlphaProgram.ProgramObj);
+        depthAlphaProgram.SetUniform("lightSpaceMatrix", projection * view);
     }
 
+    //fill render queue: twosided (transparent) objects without face culling, opaque objects with it
+    RenderPass surfacePass = deferred ? RenderPass::GBUFFER_PASS : RenderPass::LIGHTING_PASS;
+    RenderProgram surfaceProgramSlot = deferred ? RenderProgram::GBUFFER_PROGRAM : RenderProgram::LIGHTING_PROGRAM;
+    renderQueue.Clear();
     for (std::size_t i = 0; i < 2; ++i) {
-        if (i == 0) {
-            //transparent objects
-            glDisable(GL_CULL_FACE);
-        } else {
-            //opaque objects
-            glEnable(GL_CULL_FACE);
-        }
+        CullMode cullMode = i == 0 ? CullMode::CULL_NONE : CullMode::CULL_BACK;
         for (std::size_t j : sideSplit[i]) {
             if (j == lightIdx) {
                 continue;
             }
-            //set material
-            uint32_t matId = scene[j]->matId;
-            materials[matId].Setup(
-                lightningProgram,
-                textures,
-                GL_TEXTURE0,
-                GL_TEXTURE1,
-                GL_TEXTURE2,
-                0,
-                1,
-                2);
-            if (duplicatedModels.count(j)) {
-                for (auto& model : duplicatedModels[j]) {
-                    //TODO: use instancing here
-                    glm::mat3 normalMatrix = glm::transpose(glm::inverse(view * model));
-                    lightningProgram.SetUniform("model", model);
-                    lightningProgram.SetUniform("normalMatrix", normalMatrix);
-                    scene[j]->Draw();
+            renderQueue.Push(surfacePass, cullMode, surfaceProgramSlot, scene[j]->matId, j);
+            if (depthPrePass) {
+                //twosided materials are alpha tested and need their textures, opaque ones share default material
+                if (cullMode == CullMode::CULL_NONE) {
+                    renderQueue.Push(RenderPass::DEPTH_PREPASS, cullMode, RenderProgram::DEPTH_ALPHA_PROGRAM, scene[j]->matId, j);
+                } else {
+                    renderQueue.Push(RenderPass::DEPTH_PREPASS, cullMode, RenderProgram::DEPTH_PROGRAM, 0, j);
                 }
-            } else {
-                glm::mat3 normalMatrix = glm::transpose(glm::inverse(view * scene[j]->model));
-                lightningProgram.SetUniform("model", scene[j]->model);
-                lightningProgram.SetUniform("normalMatrix", normalMatrix);
-                scene[j]->Draw();
             }
-            glBindTexture(GL_TEXTURE_2D, 0);
         }
     }
-
-    glUseProgram(sourceProgram.ProgramObj); //StartUseShader
-    for (std::size_t i = 0; i < lightPos.size(); ++i) {
-        //model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, lightPos[i]);
-        model = glm::scale(model, glm::vec3(10.0f));
-        //set uniforms with transforms
-        sourceProgram.SetUniform("model", model);
-        sourceProgram.SetUniform("view", view);
-        sourceProgram.SetUniform("projection", projection);
-        //color
-        sourceProgram.SetUniform("lightColor", lightColors[i] + glm::vec3(0.1));
-        scene[lightIdx]->Draw();
+    if (!deferred) {
+        renderQueue.Push(RenderPass::LIGHT_SOURCES_PASS, CullMode::CULL_BACK, RenderProgram::SOURCE_PROGRAM, 0, lightIdx);
     }
+    renderQueue.Sort();
+    CullingView cameraView;
+    cameraView.frustum = Frustum(projection * view);
+    cameraView.position = state.camera.Position;
+    cullingStats = CullingStats();
+    cameraView.stats = &cullingStats;
+    if (config["occlusionCulling"]) {
+        hiZBuffer.Update();
+        cameraView.occlusion = &hiZBuffer;
+    }
+    std::vector<ShaderProgram*> programs(RenderProgram::NUM_PROGRAMS);
+    programs[RenderProgram::LIGHTING_PROGRAM] = &lightningProgram;
+    programs[RenderProgram::SOURCE_PROGRAM] = &sourceProgram;
+    programs[RenderProgram::DEPTH_PROGRAM] = &depthProgram;
+    programs[RenderProgram::DEPTH_ALPHA_PROGRAM] = &depthAlphaProgram;
+    programs[RenderProgram::GBUFFER_PROGRAM] = &gBufferProgram;
+    if (deferred) {
+        glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+        static const float zeros[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 3; ++i) {
+            glClearBufferfv(GL_COLOR, i, zeros);
+        }
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    submitRenderQueue(programs, cameraView);
+    //restore default depth test and color writes
+    setupRenderPass(RenderPass::LIGHT_SOURCES_PASS);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glUseProgram(0); //StoptUseShader
-
-    //blit from multisampled texture
-    glReadBuffer(GL_COLOR_ATTACHMENT1);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, pongFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[0], 0);
-
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, colorBufferFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pongFBO);
-    glBlitFramebuffer(0, 0, config["width"], config["height"], 0, 0, config["width"], config["height"], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    if (deferred) {
+        //shade every covered pixel once, depth from G-buffer is written for light sources
+        glBindFramebuffer(GL_FRAMEBUFFER, colorBufferFBO);
+        if (state.filling == 0) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+        glDepthFunc(GL_ALWAYS);
+        gpuProfiler.BeginZone("deferred shading");
+        RenderStats::SetPass("deferred shading");
+        glUseProgram(deferredProgram.ProgramObj);
+        //color attachments take units of material textures, depth goes after shadow maps
+        std::vector<std::string> names = { "gAlbedo", "gNormal", "gSpecular", "gDepth" };
+        std::vector<int> units = { 0, 1, 2, 10 };
+        for (std::uint32_t i = 0; i < gBufferTextures.size(); ++i) {
+            glActiveTexture(GL_TEXTURE0 + units[i]);
+            glBindTexture(GL_TEXTURE_2D, gBufferTextures[i]);
+            deferredProgram.SetUniform(names[i], units[i]);
+        }
+        glBindVertexArray(quadVAO);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+        glBindVertexArray(0);
+        GL_CHECK_ERRORS;
+        gpuProfiler.EndZone();
+        glDepthFunc(GL_LESS);
+        if (state.filling == 0) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        }
 
-    //------------------------------------------------------------------
-    //Gaussian smoothing for bloom effect
-    //------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, pongFBO);
-    glUseProgram(quadColorProgram.ProgramObj); //StartUseShader
-    glDisable(GL_DEPTH_TEST);
+        renderQueue.Clear();
+        renderQueue.Push(RenderPass::LIGHT_SOURCES_PASS, CullMode::CULL_BACK, RenderProgram::SOURCE_PROGRAM, 0, lightIdx);
+        submitRenderQueue(programs, cameraView);
+    }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(quadVAO);
-    for (std::uint32_t i = 0; i < 4; ++i) {
-        //x-axis
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[1], 0);
-        glBindTexture(GL_TEXTURE_2D, pongTextures[0]);
-        quadColorProgram.SetUniform("colorBuffer", 0);
-        quadColorProgram.SetUniform("gaussFilter", true);
-        quadColorProgram.SetUniform("direction", true);
-        quadColorProgram.SetUniform("addBloom", false);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-
-        //y-axis
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[0], 0);
-        glBindTexture(GL_TEXTURE_2D, pongTextures[1]);
-        quadColorProgram.SetUniform("direction", false);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+    //depth of this frame is used for occlusion culling in next frames
+    if (config["occlusionCulling"]) {
+        gpuProfiler.BeginZone("hi-z");
+        RenderStats::SetPass("post-processing");
+        hiZBuffer.Build(colorBufferFBO, renderSize, hiZProgram, quadVAO, projection * view);
+        glBindFramebuffer(GL_FRAMEBUFFER, colorBufferFBO);
+        gpuProfiler.EndZone();
     }
 
+    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, 0);
-    glBindVertexArray(0);
     glUseProgram(0); //StoptUseShader
-}
-
-void App::visualizeScene(ShaderProgram& quadColorProgram)
-{
-    //blit from multisampled texture
-    glBindFramebuffer(GL_FRAMEBUFFER, colorBufferFBO);
-    glReadBuffer(GL_COLOR_ATTACHMENT0);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, pongFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[1], 0);
+    gpuProfiler.BeginZone("resolve");
+    RenderStats::SetPass("post-processing");
+    GLuint brightColorTexture = colorBufferTextures[1];
+    sceneColorTexture = colorBufferTextures[0];
+    if (antiAliasing.GetSamples() > 1) {
+        //blit from multisampled textures
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, colorBufferFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pongFBO);
+        for (std::uint32_t i = 0; i < 2; ++i) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pongTextures[1 - i], 0);
+            glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, renderSize.x, renderSize.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        sceneColorTexture = pongTextures[1];
+        brightColorTexture = pongTextures[0];
+    } else {
+        //accumulate jittered frames
+        sceneColorTexture = antiAliasing.ResolveTemporal(
+            colorBufferTextures[0],
+            colorBufferDepthTexture,
+            uvScale,
+            taaProgram,
+            quadVAO,
+            projection * view,
+            unjitteredProjection * view);
+    }
+    GL_CHECK_ERRORS;
+    gpuProfiler.EndZone();
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, colorBufferFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pongFBO);
-    glBlitFramebuffer(0, 0, config["width"], config["height"], 0, 0, config["width"], config["height"], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    //bright color is blurred by mip chain, every level widens bloom
+    gpuProfiler.BeginZone("bloom");
+    bloomChain.Build(brightColorTexture, uvScale, bloomProgram, quadVAO);
+    gpuProfiler.EndZone();
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void App::visualizeScene(ShaderProgram& quadColorProgram, ShaderProgram& fxaaProgram)
+{
+    //tone mapped image goes to screen or to FXAA target
+    glBindFramebuffer(GL_FRAMEBUFFER, antiAliasing.GetFXAATarget(outputFBO));
 
     //disable depth testing
     glDisable(GL_DEPTH_TEST);
 
+    //rendered part of scene is upscaled to the whole window
+    glViewport(0, 0, config["width"], config["height"]);
+
     glUseProgram(quadColorProgram.ProgramObj); //StartUseShader
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, pongTextures[1]);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, pongTextures[0]);
+    glBindTexture(GL_TEXTURE_2D, sceneColorTexture);
+    bloomChain.Bind(1);
     quadColorProgram.SetUniform("colorBuffer", 0);
     quadColorProgram.SetUniform("bloomBuffer", 1);
-    quadColorProgram.SetUniform("gaussFilter", false);
-    quadColorProgram.SetUniform("direction", false);
+    quadColorProgram.SetUniform("bloomScale", 1.0f / bloomChain.GetNumLevels());
     quadColorProgram.SetUniform("addBloom", true);
+    quadColorProgram.SetUniform("uvScale", dynamicResolution.GetUVScale());
+    quadColorProgram.SetUniform("sharpen", config["upscaleFilter"] == "sharpen");
 
     glBindVertexArray(quadVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glUseProgram(0); //StopUseShader
+
+    antiAliasing.ApplyFXAA(fxaaProgram, quadVAO, outputFBO);
 }
 
 namespace {
@@ -974,6 +1382,58 @@ std::string to_string_with_precision(const T a_value, const int n = 6)
 }
 }
 
+void App::finishFrame(std::uint64_t frame, float cpuTime, bool playback)
+{
+    RenderStats::EndFrame();
+    if (renderStatsLog.is_open()) {
+        RenderStats::WriteCSV(renderStatsLog, frame);
+    }
+    if (config["dumpFrames"] != "" && frame % std::max(1u, static_cast<std::uint32_t>(config["dumpEvery"])) == 0) {
+        dumpFrame(frame);
+    }
+    //GPU times arrive a few frames late, they are matched by frame index
+    auto gpuTimes = gpuProfiler.TakeFrameTimes();
+    if (playback) {
+        playbackCpuTimes.push_back(cpuTime);
+        for (const auto& item : gpuTimes) {
+            if (item.first >= playbackGpuTimes.size()) {
+                playbackGpuTimes.resize(item.first + 1, -1.0f);
+            }
+            playbackGpuTimes[item.first] = item.second;
+        }
+    }
+}
+
+void App::writePlaybackLog()
+{
+    std::ofstream log(config["playbackLog"].get<std::string>());
+    if (!log.good()) {
+        throw std::runtime_error("Failed to open " + config["playbackLog"].get<std::string>());
+    }
+    float step = 1.0f / static_cast<float>(config["playbackFPS"]);
+    float cpuSum = 0.0f;
+    float gpuSum = 0.0f;
+    std::size_t gpuFrames = 0;
+    log << "frame,time,cpu_ms,gpu_ms\n";
+    for (std::size_t i = 0; i < playbackCpuTimes.size(); ++i) {
+        float gpuTime = i < playbackGpuTimes.size() ? playbackGpuTimes[i] : -1.0f;
+        log << i << "," << i * step << "," << playbackCpuTimes[i] << ",";
+        if (gpuTime >= 0.0f) {
+            log << gpuTime;
+            gpuSum += gpuTime;
+            ++gpuFrames;
+        }
+        log << "\n";
+        cpuSum += playbackCpuTimes[i];
+    }
+    std::cout << "Camera path: " << playbackCpuTimes.size() << " frames, CPU avg "
+              << to_string_with_precision(cpuSum / std::max<std::size_t>(playbackCpuTimes.size(), 1), 2) << " ms";
+    if (gpuFrames > 0) {
+        std::cout << ", GPU avg " << to_string_with_precision(gpuSum / gpuFrames, 2) << " ms";
+    }
+    std::cout << std::endl;
+}
+
 void App::mainLoop()
 {
     //create shader programs
@@ -983,11 +1443,26 @@ void App::mainLoop()
     ShaderProgram lightningProgram(shaders);
     GL_CHECK_ERRORS;
 
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexPhong.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentGBuffer.glsl";
+    ShaderProgram gBufferProgram(shaders);
+    GL_CHECK_ERRORS;
+
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentDeferred.glsl";
+    ShaderProgram deferredProgram(shaders);
+    GL_CHECK_ERRORS;
+
     shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexDepth.glsl";
     shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentDepth.glsl";
     ShaderProgram depthProgram(shaders);
     GL_CHECK_ERRORS;
 
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexDepth.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentDepthAlpha.glsl";
+    ShaderProgram depthAlphaProgram(shaders);
+    GL_CHECK_ERRORS;
+
     shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
     shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentQuadColor.glsl";
     ShaderProgram quadColorProgram(shaders);
@@ -1003,17 +1478,54 @@ void App::mainLoop()
     ShaderProgram sourceProgram(shaders);
     GL_CHECK_ERRORS;
 
-    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexPointDepth.glsl";
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexPointDepthFace.glsl";
     shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentPointDepth.glsl";
-    shaders[GL_GEOMETRY_SHADER] = shadersPath + "/geometryPointDepth.glsl";
     ShaderProgram pointDepthPorgram(shaders);
     GL_CHECK_ERRORS;
 
-    //force 60 frames per second
-    glfwSwapInterval(1);
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentHiZ.glsl";
+    ShaderProgram hiZProgram(shaders);
+    GL_CHECK_ERRORS;
+
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentBloom.glsl";
+    ShaderProgram bloomProgram(shaders);
+    GL_CHECK_ERRORS;
+
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentMoments.glsl";
+    ShaderProgram momentsProgram(shaders);
+    GL_CHECK_ERRORS;
+
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentTAA.glsl";
+    ShaderProgram taaProgram(shaders);
+    GL_CHECK_ERRORS;
+
+    shaders[GL_VERTEX_SHADER] = shadersPath + "/vertexQuad.glsl";
+    shaders[GL_FRAGMENT_SHADER] = shadersPath + "/fragmentFXAA.glsl";
+    ShaderProgram fxaaProgram(shaders);
+    GL_CHECK_ERRORS;
+
+    //wait for display refresh unless frame rate is measured or limited by frameTimer
+    bool headless = config["headless"];
+    glfwSwapInterval(config["vsync"] && !headless ? 1 : 0);
+    frameTimer.Setup(config["targetFPS"], config["benchmarkFrames"]);
+    if (config["gpuProfiler"]) {
+        gpuProfiler.Setup(64, config["gpuProfileLog"]);
+    }
+    if (config["renderStatsLog"] != "") {
+        renderStatsLog.open(config["renderStatsLog"]);
+        if (!renderStatsLog.good()) {
+            throw std::runtime_error("Failed to open " + std::string(config["renderStatsLog"]));
+        }
+    }
 
     //capture cursor
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!headless) {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     //register callbacks
     glfwSetKeyCallback(window, OnKeyboardPressed);
@@ -1021,11 +1533,43 @@ void App::mainLoop()
     glfwSetMouseButtonCallback(window, OnMouseButtonClicked);
     glfwSetScrollCallback(window, OnMouseScroll);
 
+    //with dynamic resolution off scale stays 1, frame time is still measured
+    dynamicResolution.Setup(
+        config["width"],
+        config["height"],
+        config["dynamicResolution"] ? static_cast<float>(config["minResolutionScale"]) : 1.0f,
+        config["targetFrameTime"]);
+
     //setup framebuffers and quad to render resulting textures
+    antiAliasing.Setup(config["width"], config["height"], AntiAliasing::ModeFromString(config["antiAliasing"]));
     setupColorBuffer();
+    setupOutputBuffer();
+    if (config["renderingPath"] == "deferred") {
+        setupGBuffer();
+    }
     setupShadowMapBuffer();
-    setupPointShadowMapBuffer();
+    //moments aren't needed with PCF (cascades always use it)
+    if (dirShadowFilter != 0) {
+        momentShadowMap.Setup(
+            shadowMapWidth,
+            shadowMapHeight,
+            static_cast<MomentFilter>(dirShadowFilter),
+            config["momentBits"]);
+    }
+    shadowAtlas.Setup(
+        config["shadowAtlasSize"],
+        lightPos.size(),
+        config["pointShadowMinResolution"],
+        config["pointShadowMaxResolution"]);
     setupQuad();
+    if (config["occlusionCulling"]) {
+        hiZBuffer.Setup(config["width"], config["height"]);
+    }
+    bloomChain.Setup(config["width"], config["height"], config["bloomLevels"]);
+    lightClusters.Setup(extraLights.size());
+    if (config["shadowCascades"] > 0) {
+        shadowCascades.Setup(config["shadowCascades"], config["cascadeResolution"]);
+    }
 
     //find flagpoles
     std::vector<std::vector<uint32_t>> poles(2);
@@ -1064,15 +1608,21 @@ void App::mainLoop()
                 cloths[i]->mesh2->matId = mat.first;
             }
         }
-        //load to GPU and add to scene
+        //one instance per flagpole, load to GPU and add to scene
+        cloths[i]->mesh1->SetInstances(modelMats[i]);
+        cloths[i]->mesh2->SetInstances(modelMats[i]);
         cloths[i]->mesh1->GLLoad();
         cloths[i]->mesh2->GLLoad();
         scene.push_back(cloths[i]->mesh1);
         scene.push_back(cloths[i]->mesh2);
         sideSplit[0].push_back(scene.size() - 2);
         sideSplit[0].push_back(scene.size() - 1);
-        duplicatedModels[scene.size() - 2] = modelMats[i];
-        duplicatedModels[scene.size() - 1] = modelMats[i];
+    }
+    //everything except light cubes casts shadows
+    for (std::size_t i = 0; i < scene.size(); ++i) {
+        if (i != lightIdx) {
+            shadowCasters.push_back(i);
+        }
     }
     std::vector<glm::dvec3> accelerations = {
         glm::dvec3(0.0, -9.8, 0.0),
@@ -1081,11 +1631,26 @@ void App::mainLoop()
 
     //main loop with scene rendering at every frame
     uint32_t frameCount = 0;
+    std::uint64_t frameNumber = 0;
+    //camera path is played back with fixed time step, so every run renders the same frames
+    bool playback = config["cameraPlayback"];
+    float playbackStep = 1.0f / static_cast<float>(config["playbackFPS"]);
+    if (playback) {
+        cameraPath.Load(config["cameraPath"]);
+        playbackCpuTimes.clear();
+        playbackGpuTimes.clear();
+    }
     float deltaSum = 0.0f;
     bool firstFrame = true;
     //TODO: move FPS logic to separate class
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && !frameTimer.IsFinished()) {
+        PROFILE_SCOPE("frame");
+        if (playback && frameNumber * playbackStep > cameraPath.GetDuration()) {
+            break;
+        }
         //per-frame time logic
+        frameTimer.BeginFrame();
+        auto cpuStart = std::chrono::steady_clock::now();
         float currentFrame = glfwGetTime();
         ++frameCount;
         if (firstFrame) {
@@ -1104,19 +1669,71 @@ void App::mainLoop()
         deltaSum += state.deltaTime;
         if (deltaSum >= printEvery) {
             float fps = static_cast<float>(frameCount) / deltaSum;
-            std::string title = std::string(config["name"]) + " FPS: " + to_string_with_precision(fps, 1);
+            std::string title = std::string(config["name"]) + " FPS: " + to_string_with_precision(fps, 1)
+                + " Meshlets: " + std::to_string(cullingStats.visible)
+                + " visible, culled by frustum " + std::to_string(cullingStats.frustumCulled)
+                + ", cone " + std::to_string(cullingStats.backfaceCulled)
+                + ", occlusion " + std::to_string(cullingStats.occlusionCulled)
+                + " Resolution: " + to_string_with_precision(dynamicResolution.GetScale() * 100.0f, 0) + "%";
+            if (config["gpuProfiler"]) {
+                title += " GPU ms: " + gpuProfiler.GetSummary();
+            }
+            if (state.showRenderStats) {
+                RenderStats::Print(std::cout);
+            }
             glfwSetWindowTitle(window, title.c_str());
             deltaSum = 0.0f;
             frameCount = 0;
         }
 
         //handle events
-        glfwPollEvents();
-        doCameraMovement();
+        {
+            PROFILE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
+        float simulationTime = currentFrame;
+        if (playback) {
+            state.deltaTime = frameNumber == 0 ? 0.0f : playbackStep;
+            simulationTime = frameNumber * playbackStep;
+            cameraPath.Apply(simulationTime, state.camera);
+        } else {
+            doCameraMovement();
+        }
+
+        //R starts and stops recording, C adds current camera to path
+        if (state.toggleRecording) {
+            state.toggleRecording = false;
+            recordingPath = !recordingPath;
+            if (recordingPath) {
+                cameraPath.Clear();
+                recordingStart = currentFrame;
+                std::cout << "Recording camera path, add keys with C" << std::endl;
+            } else {
+                cameraPath.Save(config["cameraPath"]);
+                std::cout << "Camera path with " << cameraPath.GetNumKeys() << " keys saved to "
+                          << std::string(config["cameraPath"]) << std::endl;
+            }
+        }
+        if (state.addPathKey) {
+            state.addPathKey = false;
+            if (recordingPath) {
+                cameraPath.AddKey(state.camera, currentFrame - recordingStart);
+            }
+        }
+
+        //next anti-aliasing mode needs color buffer with different number of samples
+        if (state.switchAntiAliasing) {
+            state.switchAntiAliasing = false;
+            AntiAliasingMode mode = static_cast<AntiAliasingMode>((static_cast<int>(antiAliasing.GetMode()) + 1) % 3);
+            deleteColorBuffer();
+            antiAliasing.Setup(config["width"], config["height"], mode);
+            setupColorBuffer();
+            std::cout << "Anti-aliasing: " << AntiAliasing::ModeToString(mode) << std::endl;
+        }
 
         //recompute wind force
-        accelerations[1].x = 7.0 * sin(currentFrame / 3.0);
-        accelerations[1].z = 5.0 * sin(currentFrame / 6.0 + 2.0);
+        accelerations[1].x = 7.0 * sin(simulationTime / 3.0);
+        accelerations[1].z = 5.0 * sin(simulationTime / 6.0 + 2.0);
         // simulate cloth movement
         // TODO: it's possible to parallelize this
         for (auto& cloth : cloths) {
@@ -1132,37 +1749,99 @@ void App::mainLoop()
             cloth->mesh2->GLUpdatePositionsNormals();
         }
 
+        //GPU time of frame sets resolution of next frames
+        dynamicResolution.BeginFrame();
+        gpuProfiler.BeginFrame();
+
         //render shadow map to shadowMapTexture
-        renderShadowMap(depthProgram, quadDepthProgram);
+        gpuProfiler.BeginZone("shadows");
+        RenderStats::SetPass("shadows");
+        renderShadowMap(depthProgram, momentsProgram);
+        gpuProfiler.EndZone();
 
         //visualize shadow map
         if (state.renderingMode == RenderingMode::SHADOW_MAP) {
             //draw texture with shadow map to quad
             visualizeShadowMap(quadDepthProgram);
-            glfwSwapBuffers(window);
+            gpuProfiler.EndFrame();
+            dynamicResolution.EndFrame();
+            finishFrame(frameNumber++, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuStart).count(), playback);
+            {
+                PROFILE_SCOPE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            frameTimer.EndFrame();
             continue;
         }
 
-        //render point shadow map to pointShadowMapTexture
-        renderPointShadowMap(pointDepthPorgram);
+        //render faces of point shadow maps to shadow atlas
+        gpuProfiler.BeginZone("point shadows");
+        RenderStats::SetPass("point shadows");
+        renderPointShadowMap(pointDepthPorgram, Frustum(getProjection() * state.camera.GetViewMatrix()));
+        gpuProfiler.EndZone();
 
         //render scene to colorBufferTexture
-        renderScene(lightningProgram, sourceProgram, quadColorProgram);
+        gpuProfiler.BeginZone("scene");
+        RenderStats::SetPass("scene setup");
+        renderScene(
+            lightningProgram,
+            sourceProgram,
+            bloomProgram,
+            hiZProgram,
+            depthProgram,
+            depthAlphaProgram,
+            gBufferProgram,
+            deferredProgram,
+            taaProgram);
+        gpuProfiler.EndZone();
 
         //draw texture with rendered scene to quad
         if (state.filling == 0) {
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
-        visualizeScene(quadColorProgram);
-        glfwSwapBuffers(window);
+        gpuProfiler.BeginZone("composite");
+        RenderStats::SetPass("composite");
+        visualizeScene(quadColorProgram, fxaaProgram);
+        gpuProfiler.EndZone();
+        gpuProfiler.EndFrame();
+        dynamicResolution.EndFrame();
+        finishFrame(frameNumber++, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuStart).count(), playback);
+        {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        frameTimer.EndFrame();
         if (state.filling == 0) {
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         }
     }
     lightningProgram.Release();
+    gBufferProgram.Release();
+    deferredProgram.Release();
     depthProgram.Release();
+    depthAlphaProgram.Release();
     quadColorProgram.Release();
     quadDepthProgram.Release();
+    hiZProgram.Release();
+    bloomProgram.Release();
+    momentsProgram.Release();
+    taaProgram.Release();
+    fxaaProgram.Release();
+
+    if (config["benchmarkFrames"] != 0) {
+        frameTimer.PrintStats(std::cout);
+    }
+    if (playback) {
+        //frames still in flight
+        gpuProfiler.Flush();
+        for (const auto& item : gpuProfiler.TakeFrameTimes()) {
+            if (item.first < playbackCpuTimes.size()) {
+                playbackGpuTimes.resize(std::max<std::size_t>(playbackGpuTimes.size(), item.first + 1), -1.0f);
+                playbackGpuTimes[item.first] = item.second;
+            }
+        }
+        writePlaybackLog();
+    }
 }
 
 void App::release()
@@ -1175,10 +1854,23 @@ void App::release()
         item.second->Release();
         GL_CHECK_ERRORS;
     }
+    staticMeshBuffer.Release();
+    hiZBuffer.Release();
+    bloomChain.Release();
+    dynamicResolution.Release();
+    gpuProfiler.Release();
+    lightClusters.Release();
+    shadowCascades.Release();
     deleteQuad();
     deleteColorBuffer();
+    deleteOutputBuffer();
+    antiAliasing.Release();
+    if (config["renderingPath"] == "deferred") {
+        deleteGBuffer();
+    }
     deleteShadowMapBuffer();
-    deletePointShadowMapBuffer();
+    momentShadowMap.Release();
+    shadowAtlas.Release();
     glfwTerminate();
 }
 
@@ -1189,13 +1881,32 @@ int App::Run()
     if (result != 0) {
         return result;
     }
-    for (std::size_t i = 0; i < scene.size(); ++i) {
-        scene[i]->GLLoad();
-    }
-    for (auto& item : textures) {
-        item.second->GLLoad();
+    {
+        PROFILE_SCOPE("GLLoad");
+        //pack static meshes into shared buffers if requested, load other meshes separately
+        if (config["staticMeshBuffer"]) {
+            std::vector<std::size_t> staticMeshes;
+            for (std::size_t i = 0; i < scene.size(); ++i) {
+                if (scene[i]->isStatic && i != lightIdx) {
+                    staticMeshes.push_back(i);
+                }
+            }
+            staticMeshBuffer.GLLoad(scene, staticMeshes, config["quantizePositions"]);
+        }
+        for (std::size_t i = 0; i < scene.size(); ++i) {
+            if (!staticMeshBuffer.Contains(i)) {
+                scene[i]->quantizePositions = scene[i]->isStatic && config["quantizePositions"];
+                scene[i]->GLLoad();
+            }
+        }
+        for (auto& item : textures) {
+            item.second->GLLoad();
+        }
     }
     mainLoop();
     release();
+    if (CpuProfiler::enabled && config["cpuProfileTrace"] != "") {
+        CpuProfiler::WriteTrace(config["cpuProfileTrace"]);
+    }
     return 0;
 }
@@ -0,0 +1,128 @@
+#include "BloomChain.h"
+#include <algorithm>
+#include <cmath>
+
+void BloomChain::Setup(std::uint32_t width, std::uint32_t height, int numLevels_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    //levels stop at a few texels, smaller ones only add blocky artifacts
+    int maxLevels = static_cast<int>(std::floor(std::log2(std::min(width, height)))) - 2;
+    numLevels = std::min(std::max(numLevels_, 1), std::max(maxLevels, 1));
+    levelSizes.clear();
+    for (int level = 0; level < numLevels; ++level) {
+        levelSizes.push_back(glm::ivec2(std::max(1u, width >> (level + 1)), std::max(1u, height >> (level + 1))));
+    }
+
+    //11-11-10 float has enough range for HDR bloom and halves bandwidth of RGB16F
+    glGenTextures(1, &texture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GL_CHECK_ERRORS;
+    for (int level = 0; level < numLevels; ++level) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R11F_G11F_B10F, levelSizes[level].x, levelSizes[level].y, 0, GL_RGB, GL_FLOAT, nullptr);
+        GL_CHECK_ERRORS;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    GL_CHECK_ERRORS;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    isLoaded = true;
+}
+
+void BloomChain::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &texture);
+    GL_CHECK_ERRORS;
+    numLevels = 0;
+    isLoaded = false;
+}
+
+void BloomChain::selectLevel(int level)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+}
+
+void BloomChain::Build(GLuint sourceTexture, const glm::vec2& uvScale, ShaderProgram& program, GLuint quadVAO)
+{
+    if (!isLoaded) {
+        return;
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(program.ProgramObj);
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE0);
+    program.SetUniform("sourceBuffer", 0);
+    program.SetUniform("uvScale", uvScale);
+
+    //downsample: every level is 13 taps of the previous one (the first one reads full resolution color)
+    program.SetUniform("upsample", false);
+    for (int level = 0; level < numLevels; ++level) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, sourceTexture);
+        } else {
+            selectLevel(level - 1);
+        }
+        //average of full resolution is weighted by luminance to suppress fireflies
+        program.SetUniform("firstLevel", level == 0);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+        GL_CHECK_ERRORS;
+    }
+
+    //upsample: tent filter of smaller level is added to larger one
+    program.SetUniform("upsample", true);
+    program.SetUniform("firstLevel", false);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int level = numLevels - 2; level >= 0; --level) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+        selectLevel(level + 1);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+        GL_CHECK_ERRORS;
+    }
+    glDisable(GL_BLEND);
+
+    selectLevel(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    GL_CHECK_ERRORS;
+}
+
+void BloomChain::Bind(int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, isLoaded ? texture : 0);
+    GL_CHECK_ERRORS;
+}
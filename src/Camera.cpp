@@ -73,6 +73,13 @@ void Camera::ProcessMouseScroll(float yoffset)
         Zoom = ZOOM;
 }
 
+void Camera::SetOrientation(float yaw, float pitch)
+{
+    Yaw = yaw;
+    Pitch = pitch;
+    updateCameraVectors();
+}
+
 void Camera::updateCameraVectors()
 {
     // calculate the new Front vector
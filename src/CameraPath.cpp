@@ -0,0 +1,127 @@
+#include "CameraPath.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+namespace {
+
+//tangent at key from neighbours (finite difference), scaled to segment length,
+//so uneven spacing of keys doesn't overshoot
+template <typename T>
+T tangent(const T& prev, const T& next, float prevTime, float nextTime, float segment)
+{
+    return nextTime > prevTime ? (next - prev) / (nextTime - prevTime) * segment : T(0.0f);
+}
+
+template <typename T>
+T hermite(const T& p0, const T& m0, const T& p1, const T& m1, float u)
+{
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return (2.0f * u3 - 3.0f * u2 + 1.0f) * p0
+        + (u3 - 2.0f * u2 + u) * m0
+        + (-2.0f * u3 + 3.0f * u2) * p1
+        + (u3 - u2) * m1;
+}
+
+}
+
+void CameraPath::AddKey(const Camera& camera, float time)
+{
+    if (!keys.empty() && time <= keys.back().time) {
+        time = keys.back().time + 1e-3f;
+    }
+    CameraKey key = { time, camera.Position, camera.Yaw, camera.Pitch };
+    //yaw isn't wrapped, but keep it close to previous key, so camera turns the short way
+    if (!keys.empty()) {
+        key.yaw += 360.0f * std::round((keys.back().yaw - key.yaw) / 360.0f);
+    }
+    keys.push_back(key);
+}
+
+void CameraPath::Apply(float time, Camera& camera) const
+{
+    if (keys.empty()) {
+        return;
+    }
+    time = std::min(std::max(time, keys.front().time), keys.back().time);
+    //segment [i, i + 1] containing time
+    std::size_t i = std::upper_bound(
+                        keys.begin(),
+                        keys.end(),
+                        time,
+                        [](float t, const CameraKey& key) { return t < key.time; })
+        - keys.begin();
+    i = i == 0 ? 0 : i - 1;
+    if (i + 1 >= keys.size()) {
+        camera.Position = keys.back().position;
+        camera.SetOrientation(keys.back().yaw, keys.back().pitch);
+        return;
+    }
+    const CameraKey& k0 = keys[i];
+    const CameraKey& k1 = keys[i + 1];
+    const CameraKey& kPrev = keys[i == 0 ? 0 : i - 1];
+    const CameraKey& kNext = keys[std::min(i + 2, keys.size() - 1)];
+    float segment = k1.time - k0.time;
+    float u = (time - k0.time) / segment;
+
+    //position, yaw and pitch are interpolated separately
+    glm::vec3 p0(k0.position);
+    glm::vec3 p1(k1.position);
+    glm::vec3 m0 = tangent(kPrev.position, k1.position, kPrev.time, k1.time, segment);
+    glm::vec3 m1 = tangent(k0.position, kNext.position, k0.time, kNext.time, segment);
+    glm::vec2 a0(k0.yaw, k0.pitch);
+    glm::vec2 a1(k1.yaw, k1.pitch);
+    glm::vec2 n0 = tangent(glm::vec2(kPrev.yaw, kPrev.pitch), a1, kPrev.time, k1.time, segment);
+    glm::vec2 n1 = tangent(a0, glm::vec2(kNext.yaw, kNext.pitch), k0.time, kNext.time, segment);
+
+    camera.Position = hermite(p0, m0, p1, m1, u);
+    glm::vec2 angles = hermite(a0, n0, a1, n1, u);
+    camera.SetOrientation(angles.x, std::min(std::max(angles.y, -89.0f), 89.0f));
+}
+
+void CameraPath::Save(const std::string& path) const
+{
+    nlohmann::json json;
+    json["keys"] = nlohmann::json::array();
+    for (const auto& key : keys) {
+        json["keys"].push_back({
+            { "time", key.time },
+            { "position", { key.position.x, key.position.y, key.position.z } },
+            { "yaw", key.yaw },
+            { "pitch", key.pitch },
+        });
+    }
+    std::ofstream output(path);
+    if (!output.good()) {
+        throw std::runtime_error("Failed to write camera path " + path);
+    }
+    output << json.dump(4) << std::endl;
+}
+
+void CameraPath::Load(const std::string& path)
+{
+    std::ifstream input(path);
+    if (!input.good()) {
+        throw std::runtime_error("Failed to load camera path " + path);
+    }
+    nlohmann::json json;
+    input >> json;
+    keys.clear();
+    for (const auto& item : json["keys"]) {
+        CameraKey key;
+        key.time = item["time"];
+        key.position = glm::vec3(item["position"][0], item["position"][1], item["position"][2]);
+        key.yaw = item["yaw"];
+        key.pitch = item["pitch"];
+        if (!keys.empty() && key.time <= keys.back().time) {
+            throw std::runtime_error("Times of camera path keys have to increase");
+        }
+        keys.push_back(key);
+    }
+    if (keys.empty()) {
+        throw std::runtime_error("Camera path " + path + " has no keys");
+    }
+}
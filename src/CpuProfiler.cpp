@@ -0,0 +1,126 @@
+#include "CpuProfiler.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+//only the latest events of every thread are kept (24 MB per thread at most)
+const std::size_t kMaxThreadEvents = 1 << 20;
+
+struct Event {
+    const char* name;
+    std::int64_t start; //in nanoseconds since epoch
+    std::int64_t end;
+};
+
+//events are appended only by owning thread, so recording doesn't lock,
+//full buffer is used as ring, next is position of the oldest event then
+struct ThreadBuffer {
+    std::uint32_t id;
+    std::vector<Event> events;
+    std::size_t next = 0;
+
+    void Add(const Event& event)
+    {
+        if (events.size() < kMaxThreadEvents) {
+            events.push_back(event);
+        } else {
+            events[next] = event;
+            next = (next + 1) % kMaxThreadEvents;
+        }
+    }
+};
+
+//buffers are owned here, so events outlive threads that recorded them,
+//buffers of exited threads are reused, so short-lived threads don't add new ones
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+std::vector<ThreadBuffer*> freeBuffers;
+
+//takes buffer on first event of thread and returns it when thread exits
+class BufferOwner {
+public:
+    BufferOwner()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        if (!freeBuffers.empty()) {
+            buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        } else {
+            buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+            buffer = buffers.back().get();
+            buffer->id = buffers.size();
+        }
+    }
+
+    ~BufferOwner()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        freeBuffers.push_back(buffer);
+    }
+
+    BufferOwner(const BufferOwner&) = delete;
+
+    BufferOwner& operator=(const BufferOwner& other) = delete;
+
+    ThreadBuffer* buffer;
+};
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+ThreadBuffer& threadBuffer()
+{
+    //lock is taken only when thread starts and exits
+    thread_local BufferOwner owner;
+    return *owner.buffer;
+}
+
+}
+
+const bool CpuProfiler::enabled;
+
+CpuProfiler::Scope::Scope(const char* name_)
+    : name(name_)
+    , start(now())
+{
+}
+
+CpuProfiler::Scope::~Scope()
+{
+    threadBuffer().Add({ name, start, now() });
+}
+
+void CpuProfiler::WriteTrace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out.good()) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    //complete events ("X") with time in microseconds
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : buffers) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->id
+            << ",\"args\":{\"name\":\"" << "thread " << buffer->id << "\"}}";
+        first = false;
+        //from the oldest event
+        for (std::size_t i = 0; i < buffer->events.size(); ++i) {
+            const Event& event = buffer->events[(buffer->next + i) % buffer->events.size()];
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->id
+                << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}" << std::endl;
+}
@@ -0,0 +1,128 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+//scale changes in steps, so targets aren't resized by tiny amounts every frame
+const float kScaleStep = 0.05f;
+
+//frames to wait after change, so its effect is measured before the next one
+const int kSettleFrames = 8;
+
+//frame time smoothing
+const float kSmoothing = 0.1f;
+
+}
+
+const int DynamicResolution::numQueries;
+
+void DynamicResolution::Setup(std::uint32_t width_, std::uint32_t height_, float minScale_, float targetTime_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    width = width_;
+    height = height_;
+    minScale = std::min(std::max(minScale_, 0.1f), 1.0f);
+    targetTime = targetTime_;
+    scale = 1.0f;
+    frameTime = 0.0f;
+    framesSinceChange = 0;
+    nextQuery = 0;
+    glGenQueries(numQueries, queries);
+    GL_CHECK_ERRORS;
+    std::fill(pending, pending + numQueries, false);
+    isLoaded = true;
+}
+
+void DynamicResolution::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteQueries(numQueries, queries);
+    GL_CHECK_ERRORS;
+    scale = 1.0f;
+    isLoaded = false;
+}
+
+void DynamicResolution::BeginFrame()
+{
+    if (!isLoaded) {
+        return;
+    }
+    update();
+    //all queries are still in flight, skip measuring this frame
+    if (pending[nextQuery]) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]);
+    GL_CHECK_ERRORS;
+}
+
+void DynamicResolution::EndFrame()
+{
+    if (!isLoaded || pending[nextQuery]) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    GL_CHECK_ERRORS;
+    pending[nextQuery] = true;
+    nextQuery = (nextQuery + 1) % numQueries;
+}
+
+void DynamicResolution::update()
+{
+    //oldest queries finish first
+    bool measured = false;
+    for (int i = 0; i < numQueries; ++i) {
+        int query = (nextQuery + i) % numQueries;
+        if (!pending[query]) {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed);
+        pending[query] = false;
+        float time = static_cast<float>(elapsed) / 1.0e6f;
+        frameTime = frameTime == 0.0f ? time : frameTime + kSmoothing * (time - frameTime);
+        measured = true;
+    }
+    ++framesSinceChange;
+    if (!measured || framesSinceChange < kSettleFrames) {
+        return;
+    }
+
+    //GPU time is roughly proportional to number of pixels, i.e. scale^2,
+    //go down as soon as budget is exceeded and up only with clear headroom
+    float newScale = scale;
+    if (frameTime > targetTime) {
+        newScale = scale * std::sqrt(targetTime / frameTime);
+        newScale = std::floor(newScale / kScaleStep) * kScaleStep;
+    } else if (frameTime < 0.8f * targetTime) {
+        newScale = scale + kScaleStep;
+    }
+    newScale = std::min(std::max(newScale, minScale), 1.0f);
+    if (std::abs(newScale - scale) > 0.5f * kScaleStep) {
+        scale = newScale;
+        framesSinceChange = 0;
+    }
+}
+
+glm::ivec2 DynamicResolution::GetRenderSize() const
+{
+    return glm::ivec2(
+        std::max(1, static_cast<int>(std::round(width * scale))),
+        std::max(1, static_cast<int>(std::round(height * scale))));
+}
+
+glm::vec2 DynamicResolution::GetUVScale() const
+{
+    glm::ivec2 size = GetRenderSize();
+    return glm::vec2(static_cast<float>(size.x) / width, static_cast<float>(size.y) / height);
+}
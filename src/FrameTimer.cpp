@@ -0,0 +1,86 @@
+#include "FrameTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+//first frames compile shaders and fill caches, they aren't measured
+const std::uint32_t kWarmupFrames = 10;
+
+//sleep is coarse, the rest of frame is waited with busy loop
+const std::chrono::microseconds kSpinTime(1500);
+
+float percentile(const std::vector<float>& sorted, float p)
+{
+    std::size_t idx = static_cast<std::size_t>(std::ceil(p * sorted.size())) - 1;
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+}
+
+void FrameTimer::Setup(float targetFPS, std::uint32_t benchmarkFrames_)
+{
+    period = targetFPS > 0.0f
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFPS))
+        : Clock::duration::zero();
+    benchmarkFrames = benchmarkFrames_;
+    numFrames = 0;
+    frameTimes.clear();
+    frameTimes.reserve(benchmarkFrames);
+    frameStart = Clock::now();
+    nextFrame = frameStart + period;
+}
+
+void FrameTimer::BeginFrame()
+{
+    Clock::time_point now = Clock::now();
+    if (numFrames > kWarmupFrames) {
+        frameTimes.push_back(std::chrono::duration<float, std::milli>(now - frameStart).count());
+    }
+    frameStart = now;
+    ++numFrames;
+}
+
+void FrameTimer::EndFrame()
+{
+    if (period == Clock::duration::zero()) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (now >= nextFrame) {
+        //frame was late, don't try to catch up with shorter frames
+        nextFrame = now + period;
+        return;
+    }
+    if (nextFrame - now > kSpinTime) {
+        std::this_thread::sleep_for(nextFrame - now - kSpinTime);
+    }
+    while (Clock::now() < nextFrame) {
+        std::this_thread::yield();
+    }
+    nextFrame += period;
+}
+
+bool FrameTimer::IsFinished() const
+{
+    return benchmarkFrames != 0 && frameTimes.size() >= benchmarkFrames;
+}
+
+void FrameTimer::PrintStats(std::ostream& out) const
+{
+    if (frameTimes.empty()) {
+        out << "No frames measured" << std::endl;
+        return;
+    }
+    std::vector<float> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    float avg = std::accumulate(sorted.begin(), sorted.end(), 0.0f) / sorted.size();
+    out << "Frames: " << sorted.size()
+        << " min: " << sorted.front() << " ms"
+        << " avg: " << avg << " ms (" << 1000.0f / avg << " FPS)"
+        << " p95: " << percentile(sorted, 0.95f) << " ms"
+        << " p99: " << percentile(sorted, 0.99f) << " ms"
+        << " max: " << sorted.back() << " ms" << std::endl;
+}
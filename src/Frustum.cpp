@@ -0,0 +1,26 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    //rows of matrix (glm is column-major)
+    glm::mat4 m = glm::transpose(viewProjection);
+    planes[0] = m[3] + m[0]; //left
+    planes[1] = m[3] - m[0]; //right
+    planes[2] = m[3] + m[1]; //bottom
+    planes[3] = m[3] - m[1]; //top
+    planes[4] = m[3] + m[2]; //near
+    planes[5] = m[3] - m[2]; //far
+    for (auto& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
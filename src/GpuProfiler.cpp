@@ -0,0 +1,207 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+//weight of new frame in rolling average
+const float kSmoothing = 0.05f;
+
+}
+
+const int GpuProfiler::numFrames;
+
+void GpuProfiler::Setup(std::size_t maxZones_, const std::string& logPath)
+{
+    if (isLoaded) {
+        Release();
+    }
+    maxZones = maxZones_;
+    for (auto& frame : frames) {
+        frame = Frame();
+        frame.queries = std::vector<GLuint>(2 * maxZones);
+        glGenQueries(frame.queries.size(), frame.queries.data());
+        GL_CHECK_ERRORS;
+    }
+    current = 0;
+    recording = false;
+    frameIndex = 0;
+    openZones.clear();
+    paths.clear();
+    averages.clear();
+    frameTimes.clear();
+    if (!logPath.empty()) {
+        log.open(logPath);
+        if (!log.good()) {
+            throw std::runtime_error("Failed to open " + logPath);
+        }
+        log << "frame,zone,ms" << std::endl;
+    }
+    isLoaded = true;
+}
+
+void GpuProfiler::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    for (auto& frame : frames) {
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+        GL_CHECK_ERRORS;
+        frame = Frame();
+    }
+    if (log.is_open()) {
+        log.close();
+    }
+    isLoaded = false;
+}
+
+void GpuProfiler::BeginFrame()
+{
+    if (!isLoaded) {
+        return;
+    }
+    Frame& frame = frames[current];
+    if (frame.pending) {
+        //timestamps are written in order, the last one finishes last
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(frame.queries[frame.numUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        GL_CHECK_ERRORS;
+        if (!available) {
+            recording = false;
+            ++frameIndex;
+            return;
+        }
+        collect(frame);
+    }
+    frame.zones.clear();
+    frame.numUsed = 0;
+    frame.index = frameIndex++;
+    openZones.clear();
+    recording = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+    if (!isLoaded || !recording) {
+        return;
+    }
+    recording = false;
+    Frame& frame = frames[current];
+    if (frame.numUsed == 0) {
+        return;
+    }
+    frame.pending = true;
+    current = (current + 1) % numFrames;
+}
+
+void GpuProfiler::Flush()
+{
+    if (!isLoaded) {
+        return;
+    }
+    //current frame is the oldest one
+    for (int i = 0; i < numFrames; ++i) {
+        Frame& frame = frames[(current + i) % numFrames];
+        if (frame.pending) {
+            collect(frame);
+        }
+    }
+}
+
+void GpuProfiler::BeginZone(const std::string& name)
+{
+    if (!isLoaded || !recording) {
+        return;
+    }
+    Frame& frame = frames[current];
+    if (frame.zones.size() >= maxZones) {
+        //zone isn't measured, but nesting has to stay balanced
+        openZones.push_back(maxZones);
+        return;
+    }
+    Zone zone;
+    zone.path = name;
+    for (auto it = openZones.rbegin(); it != openZones.rend(); ++it) {
+        if (*it < frame.zones.size()) {
+            zone.path = frame.zones[*it].path + "/" + name;
+            break;
+        }
+    }
+    zone.begin = frame.numUsed++;
+    zone.end = zone.begin;
+    glQueryCounter(frame.queries[zone.begin], GL_TIMESTAMP);
+    GL_CHECK_ERRORS;
+    openZones.push_back(frame.zones.size());
+    frame.zones.push_back(zone);
+}
+
+void GpuProfiler::EndZone()
+{
+    if (!isLoaded || !recording || openZones.empty()) {
+        return;
+    }
+    Frame& frame = frames[current];
+    std::size_t idx = openZones.back();
+    openZones.pop_back();
+    if (idx >= frame.zones.size()) {
+        return;
+    }
+    frame.zones[idx].end = frame.numUsed++;
+    glQueryCounter(frame.queries[frame.zones[idx].end], GL_TIMESTAMP);
+    GL_CHECK_ERRORS;
+}
+
+void GpuProfiler::collect(Frame& frame)
+{
+    frame.pending = false;
+    std::vector<GLuint64> timestamps(frame.numUsed);
+    for (std::size_t i = 0; i < frame.numUsed; ++i) {
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+    GL_CHECK_ERRORS;
+    frameTimes.emplace_back(frame.index, static_cast<float>(timestamps[frame.numUsed - 1] - timestamps[0]) / 1e6f);
+
+    //sum zones with the same path
+    std::vector<float> times(paths.size(), 0.0f);
+    std::vector<bool> seen(paths.size(), false);
+    for (const auto& zone : frame.zones) {
+        if (zone.end == zone.begin) {
+            continue; //zone wasn't closed
+        }
+        std::size_t idx = std::find(paths.begin(), paths.end(), zone.path) - paths.begin();
+        if (idx == paths.size()) {
+            paths.push_back(zone.path);
+            averages.push_back(-1.0f);
+            times.push_back(0.0f);
+            seen.push_back(false);
+        }
+        times[idx] += static_cast<float>(timestamps[zone.end] - timestamps[zone.begin]) / 1e6f;
+        seen[idx] = true;
+    }
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        //zone missing in frame (e.g. no point shadows rendered) took no time
+        averages[i] = averages[i] < 0.0f ? times[i] : averages[i] + kSmoothing * (times[i] - averages[i]);
+        if (seen[i] && log.is_open()) {
+            log << frame.index << "," << paths[i] << "," << times[i] << "\n";
+        }
+    }
+}
+
+std::vector<std::pair<std::uint64_t, float>> GpuProfiler::TakeFrameTimes()
+{
+    std::vector<std::pair<std::uint64_t, float>> result;
+    result.swap(frameTimes);
+    return result;
+}
+
+std::string GpuProfiler::GetSummary() const
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        out << (i == 0 ? "" : " ") << paths[i] << " " << averages[i];
+    }
+    return out.str();
+}
@@ -0,0 +1,295 @@
+#include "HiZBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+glm::ivec2 levelSize(std::uint32_t width, std::uint32_t height, int level)
+{
+    return glm::ivec2(std::max(1u, width >> level), std::max(1u, height >> level));
+}
+
+}
+
+void HiZBuffer::Setup(std::uint32_t width_, std::uint32_t height_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    width = width_;
+    height = height_;
+    numLevels = 1 + static_cast<int>(std::floor(std::log2(std::max(width, height))));
+    readbackLevel = std::min(3, numLevels - 1);
+
+    //single sample depth texture, format has to match depth buffer for blit
+    glGenTextures(1, &depthTexture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    GL_CHECK_ERRORS;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    GL_CHECK_ERRORS;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GL_CHECK_ERRORS;
+
+    glGenFramebuffers(1, &copyFBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, copyFBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    GL_CHECK_ERRORS;
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+
+    //pyramid with all levels
+    glGenTextures(1, &hiZTexture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    GL_CHECK_ERRORS;
+    for (int level = 0; level < numLevels; ++level) {
+        glm::ivec2 size = levelSize(width, height, level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, size.x, size.y, 0, GL_RED, GL_FLOAT, nullptr);
+        GL_CHECK_ERRORS;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &pyramidFBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramidFBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiZTexture, 0);
+    GL_CHECK_ERRORS;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    //pixel buffers for asynchronous readback
+    glm::ivec2 size = levelSize(width, height, readbackLevel);
+    for (auto& readback : readbacks) {
+        glGenBuffers(1, &readback.PBO);
+        GL_CHECK_ERRORS;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size.x * size.y * sizeof(float), nullptr, GL_STREAM_READ);
+        GL_CHECK_ERRORS;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    //CPU levels from read back one to 1x1
+    levels.clear();
+    levelSizes.clear();
+    for (int level = readbackLevel; level < numLevels; ++level) {
+        levelSizes.push_back(levelSize(width, height, level));
+        levels.push_back(std::vector<float>(levelSizes.back().x * levelSizes.back().y, 1.0f));
+    }
+    hasDepth = false;
+    isLoaded = true;
+}
+
+void HiZBuffer::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    for (auto& readback : readbacks) {
+        if (readback.fence) {
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+        }
+        glDeleteBuffers(1, &readback.PBO);
+    }
+    glDeleteFramebuffers(1, &copyFBO);
+    glDeleteFramebuffers(1, &pyramidFBO);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &hiZTexture);
+    GL_CHECK_ERRORS;
+    hasDepth = false;
+    isLoaded = false;
+}
+
+void HiZBuffer::Build(GLuint sourceFBO, const glm::ivec2& sourceSize, ShaderProgram& program, GLuint quadVAO, const glm::mat4& viewProjection_)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    //resolve multisampled depth, rectangles have to match for multisampled source,
+    //rendered part is stretched over level 0 by copy pass
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFBO);
+    glBlitFramebuffer(0, 0, sourceSize.x, sourceSize.y, 0, 0, sourceSize.x, sourceSize.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    GL_CHECK_ERRORS;
+
+    //every level is max of 2x2 texels of previous one
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramidFBO);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(program.ProgramObj);
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE0);
+    program.SetUniform("depthBuffer", 0);
+    for (int level = 0; level < numLevels; ++level) {
+        glm::ivec2 size = levelSize(width, height, level);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiZTexture, level);
+        glViewport(0, 0, size.x, size.y);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+            program.SetUniform("copyDepth", true);
+            program.SetUniform("sourceScale", glm::vec2(sourceSize) / glm::vec2(width, height));
+        } else {
+            //only previous level can be read to avoid feedback loop
+            glBindTexture(GL_TEXTURE_2D, hiZTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            program.SetUniform("copyDepth", false);
+        }
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+        GL_CHECK_ERRORS;
+    }
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    //copy low resolution level to pixel buffer, it's mapped a few frames later
+    Readback& readback = readbacks[nextReadback];
+    nextReadback = (nextReadback + 1) % numReadbacks;
+    if (readback.fence) {
+        glDeleteSync(readback.fence);
+    }
+    glm::ivec2 size = levelSize(width, height, readbackLevel);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiZTexture, readbackLevel);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+    glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, nullptr);
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.viewProjection = viewProjection_;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    GL_CHECK_ERRORS;
+}
+
+void HiZBuffer::Update()
+{
+    if (!isLoaded) {
+        return;
+    }
+    //take the newest finished readback, older ones aren't needed anymore
+    bool updated = false;
+    for (int i = 1; i <= numReadbacks; ++i) {
+        Readback& readback = readbacks[(nextReadback - i + numReadbacks) % numReadbacks];
+        if (!readback.fence) {
+            continue;
+        }
+        GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            continue;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+        const float* data = static_cast<const float*>(glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, levels[0].size() * sizeof(float), GL_MAP_READ_BIT));
+        if (data) {
+            std::copy(data, data + levels[0].size(), levels[0].begin());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            viewProjection = readback.viewProjection;
+            hasDepth = true;
+            updated = true;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        GL_CHECK_ERRORS;
+        for (int j = i; j <= numReadbacks; ++j) {
+            Readback& older = readbacks[(nextReadback - j + numReadbacks) % numReadbacks];
+            if (older.fence) {
+                glDeleteSync(older.fence);
+                older.fence = nullptr;
+            }
+        }
+        break;
+    }
+    if (!updated) {
+        return;
+    }
+
+    //rest of pyramid on CPU, same reduction as in shader
+    for (std::size_t k = 1; k < levels.size(); ++k) {
+        const glm::ivec2& srcSize = levelSizes[k - 1];
+        const glm::ivec2& size = levelSizes[k];
+        for (int y = 0; y < size.y; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                int toX = (x == size.x - 1) ? srcSize.x - 1 : 2 * x + 1;
+                int toY = (y == size.y - 1) ? srcSize.y - 1 : 2 * y + 1;
+                float depth = 0.0f;
+                for (int sy = 2 * y; sy <= toY; ++sy) {
+                    for (int sx = 2 * x; sx <= toX; ++sx) {
+                        depth = std::max(depth, levels[k - 1][sy * srcSize.x + sx]);
+                    }
+                }
+                levels[k][y * size.x + x] = depth;
+            }
+        }
+    }
+}
+
+bool HiZBuffer::IsOccluded(const glm::vec3& center, float radius) const
+{
+    if (!hasDepth) {
+        return false;
+    }
+    //screen rectangle and closest depth of box around sphere
+    glm::vec3 minNdc(std::numeric_limits<float>::max());
+    glm::vec3 maxNdc(std::numeric_limits<float>::lowest());
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner = center + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f) {
+            //box intersects camera plane
+            return false;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minNdc = glm::min(minNdc, ndc);
+        maxNdc = glm::max(maxNdc, ndc);
+    }
+    float minDepth = 0.5f * minNdc.z + 0.5f;
+    if (minDepth <= 0.0f || maxNdc.x < -1.0f || maxNdc.y < -1.0f || minNdc.x > 1.0f || minNdc.y > 1.0f) {
+        return false;
+    }
+
+    //pixels covered by rectangle
+    glm::ivec2 from(
+        glm::clamp(static_cast<int>((0.5f * minNdc.x + 0.5f) * width), 0, static_cast<int>(width) - 1),
+        glm::clamp(static_cast<int>((0.5f * minNdc.y + 0.5f) * height), 0, static_cast<int>(height) - 1));
+    glm::ivec2 to(
+        glm::clamp(static_cast<int>((0.5f * maxNdc.x + 0.5f) * width), 0, static_cast<int>(width) - 1),
+        glm::clamp(static_cast<int>((0.5f * maxNdc.y + 0.5f) * height), 0, static_cast<int>(height) - 1));
+
+    //level where rectangle covers at most 2x2 texels
+    std::size_t k = 0;
+    while (k + 1 < levels.size()) {
+        int shift = readbackLevel + k;
+        if ((to.x >> shift) - (from.x >> shift) <= 1 && (to.y >> shift) - (from.y >> shift) <= 1) {
+            break;
+        }
+        ++k;
+    }
+    int shift = readbackLevel + k;
+    const glm::ivec2& size = levelSizes[k];
+    float maxDepth = 0.0f;
+    for (int y = std::min(from.y >> shift, size.y - 1); y <= std::min(to.y >> shift, size.y - 1); ++y) {
+        for (int x = std::min(from.x >> shift, size.x - 1); x <= std::min(to.x >> shift, size.x - 1); ++x) {
+            maxDepth = std::max(maxDepth, levels[k][y * size.x + x]);
+        }
+    }
+    return minDepth > maxDepth;
+}
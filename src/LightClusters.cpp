@@ -0,0 +1,318 @@
+#include "LightClusters.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace {
+
+//lists of clusters in range of depth slices
+struct SliceLists {
+    std::vector<std::uint32_t> headers; //2 per cluster: local offset, count | mask << 16
+    std::vector<std::uint32_t> indices;
+};
+
+bool intersectsAABB(const glm::vec4& sphere, const glm::vec3& min, const glm::vec3& max)
+{
+    float dist2 = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        float v = std::min(std::max(sphere[i], min[i]), max[i]) - sphere[i];
+        dist2 += v * v;
+    }
+    return dist2 <= sphere.w * sphere.w;
+}
+
+}
+
+const int LightClusters::dimX;
+const int LightClusters::dimY;
+const int LightClusters::dimZ;
+const int LightClusters::numClusters;
+const int LightClusters::maxShadowedLights;
+
+float LightClusters::EffectiveRadius(float intensity, float constant, float linear, float quadratic, float threshold)
+{
+    //solve quadratic * d^2 + linear * d + constant = intensity / threshold
+    float c = constant - intensity / threshold;
+    if (c >= 0.0f) {
+        return 0.0f;
+    }
+    if (quadratic <= 0.0f) {
+        return linear > 0.0f ? -c / linear : std::numeric_limits<float>::max();
+    }
+    return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+}
+
+void LightClusters::Setup(std::size_t maxLights_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    maxLights = maxLights_;
+    GLint maxTextureBufferSize;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+    maxTexels = maxTextureBufferSize;
+
+    glGenBuffers(1, &lightsTBO);
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_TEXTURE_BUFFER, lightsTBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(maxLights, 1) * 2 * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    GL_CHECK_ERRORS;
+    glGenTextures(1, &lightsTexture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_BUFFER, lightsTexture);
+    GL_CHECK_ERRORS;
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightsTBO);
+    GL_CHECK_ERRORS;
+
+    glGenBuffers(1, &gridTBO);
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_TEXTURE_BUFFER, gridTBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_TEXTURE_BUFFER, 2 * numClusters * sizeof(std::uint32_t), nullptr, GL_STREAM_DRAW);
+    GL_CHECK_ERRORS;
+    glGenTextures(1, &gridTexture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    GL_CHECK_ERRORS;
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, gridTBO);
+    GL_CHECK_ERRORS;
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    //calling thread takes the first part of slices,
+    //workers wait for job published after the current generation
+    int numThreads = std::max(1, std::min<int>(std::thread::hardware_concurrency(), dimZ));
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        stopWorkers = false;
+        job = nullptr;
+        pendingWorkers = 0;
+        for (int t = 1; t < numThreads; ++t) {
+            workers.emplace_back(&LightClusters::workerLoop, this, t, jobGeneration);
+        }
+    }
+    isLoaded = true;
+}
+
+LightClusters::~LightClusters()
+{
+    stopWorkerThreads();
+}
+
+void LightClusters::workerLoop(int index, std::uint64_t generation)
+{
+    while (true) {
+        const std::function<void(int)>* currentJob;
+        {
+            std::unique_lock<std::mutex> lock(workersMutex);
+            workReady.wait(lock, [&] { return stopWorkers || jobGeneration != generation; });
+            if (stopWorkers) {
+                return;
+            }
+            generation = jobGeneration;
+            currentJob = job;
+        }
+        (*currentJob)(index);
+        {
+            std::lock_guard<std::mutex> lock(workersMutex);
+            --pendingWorkers;
+        }
+        workDone.notify_one();
+    }
+}
+
+void LightClusters::runOnWorkers(const std::function<void(int)>& job_)
+{
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        job = &job_;
+        pendingWorkers = workers.size();
+        ++jobGeneration;
+    }
+    workReady.notify_all();
+    job_(0);
+    std::unique_lock<std::mutex> lock(workersMutex);
+    workDone.wait(lock, [&] { return pendingWorkers == 0; });
+    job = nullptr;
+}
+
+void LightClusters::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteTextures(1, &lightsTexture);
+    GL_CHECK_ERRORS;
+    glDeleteBuffers(1, &lightsTBO);
+    GL_CHECK_ERRORS;
+    glDeleteTextures(1, &gridTexture);
+    GL_CHECK_ERRORS;
+    glDeleteBuffers(1, &gridTBO);
+    GL_CHECK_ERRORS;
+    stopWorkerThreads();
+    isLoaded = false;
+}
+
+void LightClusters::stopWorkerThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        stopWorkers = true;
+    }
+    workReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void LightClusters::Update(
+    const glm::mat4& view,
+    float fovY,
+    float aspect,
+    float near,
+    float far,
+    const std::vector<ClusteredLight>& lights,
+    const std::vector<ClusteredLight>& shadowedLights)
+{
+    PROFILE_SCOPE("LightClusters::Update");
+    if (lights.size() > maxLights) {
+        throw std::runtime_error("Too many clustered lights");
+    }
+    if (shadowedLights.size() > maxShadowedLights) {
+        throw std::runtime_error("Too many shadowed lights");
+    }
+
+    //bounding spheres in View space, shadowed lights go first
+    std::vector<glm::vec4> spheres;
+    spheres.reserve(shadowedLights.size() + lights.size());
+    for (const auto& light : shadowedLights) {
+        spheres.push_back(glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius));
+    }
+    std::vector<glm::vec4> lightData;
+    lightData.reserve(2 * lights.size());
+    for (const auto& light : lights) {
+        spheres.push_back(glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius));
+        lightData.push_back(spheres.back());
+        lightData.push_back(glm::vec4(light.color, light.quadratic));
+    }
+    std::uint32_t numShadowed = shadowedLights.size();
+
+    //depth of slice k is near * (far / near)^(k / dimZ)
+    float logRatio = std::log(far / near);
+    depthParams = glm::vec2(dimZ / logRatio, -dimZ * std::log(near) / logRatio);
+    float tanY = std::tan(fovY / 2.0f);
+    float tanX = tanY * aspect;
+
+    auto buildSlices = [&](int sliceBegin, int sliceEnd, SliceLists& result) {
+        PROFILE_SCOPE("build light lists");
+        std::vector<std::uint32_t> candidates;
+        for (int k = sliceBegin; k < sliceEnd; ++k) {
+            float depthNear = near * std::pow(far / near, static_cast<float>(k) / dimZ);
+            float depthFar = near * std::pow(far / near, static_cast<float>(k + 1) / dimZ);
+            //lights that reach depth range of slice
+            candidates.clear();
+            for (std::uint32_t l = 0; l < spheres.size(); ++l) {
+                float depth = -spheres[l].z;
+                if (depth + spheres[l].w >= depthNear && depth - spheres[l].w <= depthFar) {
+                    candidates.push_back(l);
+                }
+            }
+            for (int j = 0; j < dimY; ++j) {
+                float y0 = -1.0f + 2.0f * j / dimY;
+                float y1 = -1.0f + 2.0f * (j + 1) / dimY;
+                for (int i = 0; i < dimX; ++i) {
+                    float x0 = -1.0f + 2.0f * i / dimX;
+                    float x1 = -1.0f + 2.0f * (i + 1) / dimX;
+                    //bounding box of cluster in View space
+                    glm::vec3 min(
+                        std::min(x0 * depthNear, x0 * depthFar) * tanX,
+                        std::min(y0 * depthNear, y0 * depthFar) * tanY,
+                        -depthFar);
+                    glm::vec3 max(
+                        std::max(x1 * depthNear, x1 * depthFar) * tanX,
+                        std::max(y1 * depthNear, y1 * depthFar) * tanY,
+                        -depthNear);
+                    std::uint32_t offset = result.indices.size();
+                    std::uint32_t mask = 0;
+                    for (std::uint32_t l : candidates) {
+                        if (!intersectsAABB(spheres[l], min, max)) {
+                            continue;
+                        }
+                        if (l < numShadowed) {
+                            mask |= 1u << l;
+                        } else {
+                            result.indices.push_back(l - numShadowed);
+                        }
+                    }
+                    std::uint32_t count = std::min<std::uint32_t>(result.indices.size() - offset, 0xFFFF);
+                    result.indices.resize(offset + count);
+                    result.headers.push_back(offset);
+                    result.headers.push_back(count | (mask << 16));
+                }
+            }
+        }
+    };
+
+    //split slices between workers and this thread
+    int numThreads = workers.size() + 1;
+    std::vector<SliceLists> lists(numThreads);
+    runOnWorkers([&](int t) {
+        buildSlices(t * dimZ / numThreads, (t + 1) * dimZ / numThreads, lists[t]);
+    });
+
+    //merge lists, offsets are counted from beginning of grid buffer
+    std::vector<std::uint32_t> grid;
+    grid.reserve(2 * numClusters);
+    std::size_t listOffset = 2 * numClusters;
+    for (const auto& slices : lists) {
+        for (std::size_t c = 0; c < slices.headers.size(); c += 2) {
+            grid.push_back(listOffset + slices.headers[c]);
+            grid.push_back(slices.headers[c + 1]);
+        }
+        listOffset += slices.indices.size();
+    }
+    for (const auto& slices : lists) {
+        grid.insert(grid.end(), slices.indices.begin(), slices.indices.end());
+    }
+    if (grid.size() > maxTexels) {
+        //drop lights from clusters that don't fit in texture buffer
+        for (std::size_t c = 0; c < 2 * numClusters; c += 2) {
+            std::uint32_t count = grid[c + 1] & 0xFFFF;
+            std::uint32_t fit = grid[c] < maxTexels ? std::min<std::size_t>(count, maxTexels - grid[c]) : 0;
+            grid[c + 1] = (grid[c + 1] & 0xFFFF0000) | fit;
+        }
+        grid.resize(maxTexels);
+    }
+    numAssigned = grid.size() - 2 * numClusters;
+
+    //orphan buffers and upload new data
+    glBindBuffer(GL_TEXTURE_BUFFER, lightsTBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(maxLights, 1) * 2 * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, lightData.size() * sizeof(glm::vec4), lightData.data());
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_TEXTURE_BUFFER, gridTBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(std::uint32_t), grid.data(), GL_STREAM_DRAW);
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Bind(ShaderProgram& program, int lightsUnit, int gridUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + lightsUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightsTexture);
+    program.SetUniform("clusterLights", lightsUnit);
+    glActiveTexture(GL_TEXTURE0 + gridUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    program.SetUniform("clusterGrid", gridUnit);
+    GL_CHECK_ERRORS;
+    program.SetUniform("clusterDims", glm::vec3(dimX, dimY, dimZ));
+    program.SetUniform("clusterDepthParams", depthParams);
+}
@@ -1,7 +1,11 @@
 #include "Models/ImportScene.h"
+#include "CpuProfiler.h"
+#include "Models/VertexFormat.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <limits>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
@@ -31,6 +35,60 @@ std::string addToDir(const std::string& directory, const std::string& path)
     return result;
 }
 
+//split mesh into parts with at most maxVertices vertices, keeping order of triangles
+void splitMesh(
+    const Mesh& mesh,
+    std::uint32_t maxVertices,
+    std::vector<std::shared_ptr<Mesh>>& parts)
+{
+    const std::uint32_t unused = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> remap(mesh.numberOfVertices(), unused);
+    std::vector<std::uint32_t> partVertices; //original indices of vertices in current part
+    std::vector<std::uint32_t> partIndices;
+
+    auto flush = [&]() {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> tangents;
+        std::vector<glm::vec3> bitangents;
+        for (std::uint32_t v : partVertices) {
+            positions.push_back(mesh.positions[v]);
+            normals.push_back(mesh.normals[v]);
+            texCoords.push_back(mesh.texCoords[v]);
+            tangents.push_back(mesh.tangents[v]);
+            bitangents.push_back(mesh.bitangents[v]);
+            remap[v] = unused;
+        }
+        parts.push_back(std::make_shared<Mesh>(
+            positions, normals, texCoords, partIndices, tangents, bitangents, mesh.matId, mesh.model));
+        parts.back()->name = mesh.name + "_" + std::to_string(parts.size());
+        partVertices.clear();
+        partIndices.clear();
+    };
+
+    for (std::uint32_t f = 0; f < mesh.numberOfFaces(); ++f) {
+        std::uint32_t newVertices = 0;
+        for (std::uint32_t j = 0; j < 3; ++j) {
+            newVertices += remap[mesh.indices[3 * f + j]] == unused;
+        }
+        if (partVertices.size() + newVertices > maxVertices) {
+            flush();
+        }
+        for (std::uint32_t j = 0; j < 3; ++j) {
+            std::uint32_t v = mesh.indices[3 * f + j];
+            if (remap[v] == unused) {
+                remap[v] = partVertices.size();
+                partVertices.push_back(v);
+            }
+            partIndices.push_back(remap[v]);
+        }
+    }
+    if (!partIndices.empty()) {
+        flush();
+    }
+}
+
 void fromAiMesh(
     const aiMesh* assimpMesh,
     const aiScene* assimpScene,
@@ -125,6 +183,7 @@ void importSceneFromFile(
     std::unordered_map<uint32_t, Material>& materials,
     std::unordered_map<std::string, std::unique_ptr<Texture>>& textures)
 {
+    PROFILE_SCOPE("importSceneFromFile");
     std::cout << "Loading scene from disk..." << std::endl;
     Assimp::Importer importer;
     const aiScene* assimpScene = importer.ReadFile(path,
@@ -230,7 +289,8 @@ void importSceneFromFile(
 //Assume all static meshes have tangents and bitangents
 std::vector<std::shared_ptr<Mesh>> unifyStaticMeshes(
     std::vector<std::shared_ptr<Mesh>>& scene,
-    const std::unordered_map<uint32_t, Material>& materials)
+    const std::unordered_map<uint32_t, Material>& materials,
+    bool splitForShortIndices)
 {
     std::unordered_map<uint32_t, std::vector<uint32_t>> materialToMeshIdx;
     for (const auto& mat : materials) {
@@ -286,6 +346,12 @@ std::vector<std::shared_ptr<Mesh>> unifyStaticMeshes(
         }
         newScene.push_back(std::make_shared<Mesh>(
             positions, normals, texCoords, indices, tangents, bitangents, item.first, glm::mat4(1.0f)));
+        //parts keep order of triangles, meshes are optimized after unification
+        if (splitForShortIndices && numVertices > MAX_SHORT_INDEX_VERTICES) {
+            std::shared_ptr<Mesh> unified = newScene.back();
+            newScene.pop_back();
+            splitMesh(*unified, MAX_SHORT_INDEX_VERTICES, newScene);
+        }
     }
     for (std::uint32_t i : skipped) {
         newScene.push_back(scene[i]);
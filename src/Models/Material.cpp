@@ -51,6 +51,27 @@ void Material::Setup(
     GL_CHECK_ERRORS;
 }
 
+void Material::SetupAlphaTest(
+    ShaderProgram& program,
+    std::unordered_map<std::string, std::unique_ptr<Texture>>& textures,
+    const GLenum diffuseTextureId,
+    int diffuseIdx)
+{
+    program.SetUniform("material.hasDiffuseMap", hasDiffuseMap && (textures.count(diffuseMapPath) > 0));
+    if (hasDiffuseMap && textures.count(diffuseMapPath)) {
+        glActiveTexture(diffuseTextureId);
+        GL_CHECK_ERRORS;
+        textures[diffuseMapPath]->GLBind();
+        GL_CHECK_ERRORS;
+        program.SetUniform("material.diffuseMap", diffuseIdx);
+        GL_CHECK_ERRORS;
+    }
+    program.SetUniform("material.opacity", opacity);
+    GL_CHECK_ERRORS;
+    program.SetUniform("material.twosided", twosided);
+    GL_CHECK_ERRORS;
+}
+
 void Material::SetMaps(
     const std::string& diffuseMapPath_,
     const std::string& specularMapPath_,
@@ -1,23 +1,18 @@
 #include "Models/Mesh.h"
+#include "CpuProfiler.h"
+#include "Models/VertexFormat.h"
 #include "common.h"
 
 void Mesh::GLLoad()
 {
+    PROFILE_SCOPE("Mesh::GLLoad");
     //generate buffers
     glGenVertexArrays(1, &VAO);
     GL_CHECK_ERRORS;
-    glGenBuffers(1, &positionsVBO);
-    GL_CHECK_ERRORS;
-    glGenBuffers(1, &normalsVBO);
-    GL_CHECK_ERRORS;
-    glGenBuffers(1, &texCoordsVBO);
+    glGenBuffers(1, &VBO);
     GL_CHECK_ERRORS;
     glGenBuffers(1, &modelsVBO);
     GL_CHECK_ERRORS;
-    glGenBuffers(1, &tangentsVBO);
-    GL_CHECK_ERRORS;
-    glGenBuffers(1, &bitangentsVBO);
-    GL_CHECK_ERRORS;
     glGenBuffers(1, &EBO);
     GL_CHECK_ERRORS;
 
@@ -26,62 +21,28 @@ void Mesh::GLLoad()
     GL_CHECK_ERRORS;
 
     {
-        //vertex positions
-        glBindBuffer(GL_ARRAY_BUFFER, positionsVBO);
-        GL_CHECK_ERRORS;
-        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GL_FLOAT) * 3, positions.data(), GL_STATIC_DRAW);
-        GL_CHECK_ERRORS;
-        glEnableVertexAttribArray(0);
-        GL_CHECK_ERRORS;
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (GLvoid*)0);
-        GL_CHECK_ERRORS;
-
-        //normals
-        glBindBuffer(GL_ARRAY_BUFFER, normalsVBO);
+        //interleaved positions, normals, texture coordinates and tangents
+        std::vector<std::uint8_t> vertices;
+        positionDequantization = packVertices(*this, quantizePositions, vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
         GL_CHECK_ERRORS;
-        glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(GL_FLOAT) * 3, normals.data(), GL_STATIC_DRAW);
-        GL_CHECK_ERRORS;
-        glEnableVertexAttribArray(1);
-        GL_CHECK_ERRORS;
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (GLvoid*)0);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), isStatic ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
         GL_CHECK_ERRORS;
+        setupPackedVertexAttributes(quantizePositions);
 
-        //texture coordinates
-        glBindBuffer(GL_ARRAY_BUFFER, texCoordsVBO);
-        GL_CHECK_ERRORS;
-        glBufferData(GL_ARRAY_BUFFER, texCoords.size() * sizeof(GL_FLOAT) * 2, texCoords.data(), GL_STATIC_DRAW);
-        GL_CHECK_ERRORS;
-        glEnableVertexAttribArray(2);
+        //indices (16-bit if possible)
+        std::vector<std::uint8_t> packedIndices;
+        indexType = indexTypeFor(numberOfVertices());
+        packIndices(indices, indexType, packedIndices);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         GL_CHECK_ERRORS;
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 2, (GLvoid*)0);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, packedIndices.size(), packedIndices.data(), GL_STATIC_DRAW);
         GL_CHECK_ERRORS;
 
-        //tangents and bitangents for normal mapping
-        if (hasTangentsBitangents) {
-            glBindBuffer(GL_ARRAY_BUFFER, tangentsVBO);
-            GL_CHECK_ERRORS;
-            glBufferData(GL_ARRAY_BUFFER, tangents.size() * sizeof(GL_FLOAT) * 3, tangents.data(), GL_STATIC_DRAW);
-            GL_CHECK_ERRORS;
-            glEnableVertexAttribArray(3);
-            GL_CHECK_ERRORS;
-            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (GLvoid*)0);
-            GL_CHECK_ERRORS;
-
-            glBindBuffer(GL_ARRAY_BUFFER, bitangentsVBO);
-            GL_CHECK_ERRORS;
-            glBufferData(GL_ARRAY_BUFFER, bitangents.size() * sizeof(GL_FLOAT) * 3, bitangents.data(), GL_STATIC_DRAW);
-            GL_CHECK_ERRORS;
-            glEnableVertexAttribArray(4);
-            GL_CHECK_ERRORS;
-            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (GLvoid*)0);
-            GL_CHECK_ERRORS;
-        }
-
-        //indices
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        GL_CHECK_ERRORS;
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        //per-instance model and normal matrices
+        glBindBuffer(GL_ARRAY_BUFFER, modelsVBO);
         GL_CHECK_ERRORS;
+        setupInstanceAttributes();
     }
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -90,31 +51,63 @@ void Mesh::GLLoad()
     GL_CHECK_ERRORS;
 
     isLoaded = true;
+
+    GLLoadInstances();
 }
 
 void Mesh::GLUpdatePositionsNormals()
 {
+    PROFILE_SCOPE("Mesh::GLUpdatePositionsNormals");
     if (!isLoaded) {
         return;
     }
-    //VAO
-    glBindVertexArray(VAO);
+    //repack all vertices, normals are interleaved with other attributes
+    std::vector<std::uint8_t> vertices;
+    glm::mat4 dequantization = packVertices(*this, quantizePositions, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
     GL_CHECK_ERRORS;
-
-    //positions
-    glBindBuffer(GL_ARRAY_BUFFER, positionsVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size(), vertices.data());
     GL_CHECK_ERRORS;
-    glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(GL_FLOAT) * 3, positions.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     GL_CHECK_ERRORS;
+    //bounding box changed, update instances
+    if (dequantization != positionDequantization) {
+        positionDequantization = dequantization;
+        GLLoadInstances();
+    }
+}
+
+std::vector<InstanceData> Mesh::GetInstanceData() const
+{
+    std::vector<InstanceData> instances(numberOfInstances());
+    for (std::size_t i = 0; i < instances.size(); ++i) {
+        glm::mat4 instanceModel = instanceModels.empty() ? model : instanceModels[i];
+        instances[i].model = instanceModel * positionDequantization;
+        instances[i].normalMatrix = glm::transpose(glm::inverse(glm::mat3(instanceModel)));
+    }
+    return instances;
+}
 
-    //normals
-    glBindBuffer(GL_ARRAY_BUFFER, normalsVBO);
+void Mesh::GLLoadInstances()
+{
+    std::vector<InstanceData> instances = GetInstanceData();
+    glBindBuffer(GL_ARRAY_BUFFER, modelsVBO);
     GL_CHECK_ERRORS;
-    glBufferSubData(GL_ARRAY_BUFFER, 0, normals.size() * sizeof(GL_FLOAT) * 3, normals.data());
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     GL_CHECK_ERRORS;
 }
 
-//draw without instancing
+void Mesh::SetInstances(const std::vector<glm::mat4>& modelMatrices)
+{
+    instanceModels = modelMatrices;
+    if (isLoaded) {
+        GLLoadInstances();
+    }
+}
+
+//draw with instancing (model matrices are taken from instance buffer)
 void Mesh::Draw() const
 {
     if (!isLoaded) {
@@ -122,43 +115,20 @@ void Mesh::Draw() const
     }
     glBindVertexArray(VAO);
     GL_CHECK_ERRORS;
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), indexType, nullptr, numberOfInstances());
     GL_CHECK_ERRORS;
     glBindVertexArray(0);
     GL_CHECK_ERRORS;
 }
 
-//draw with instancing
-void Mesh::Draw(const std::vector<glm::mat4>& modelMatrices) const
-{
-    glBindVertexArray(VAO);
-    GL_CHECK_ERRORS;
-    glBindBuffer(GL_ARRAY_BUFFER, modelsVBO);
-    GL_CHECK_ERRORS;
-    glBufferData(GL_ARRAY_BUFFER, modelMatrices.size() * sizeof(GL_FLOAT) * 16, modelMatrices.data(), GL_STATIC_DRAW);
-    GL_CHECK_ERRORS;
-    for (int i = 0; i < 4; ++i) {
-        glEnableVertexAttribArray(i + 5);
-        GL_CHECK_ERRORS;
-        glVertexAttribPointer(i + 5, 4, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 16, (GLvoid*)(sizeof(GLfloat) * i * 4));
-        GL_CHECK_ERRORS;
-        glVertexAttribDivisor(i + 5, 1);
-        GL_CHECK_ERRORS;
-    }
-    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, modelMatrices.size());
-}
-
 void Mesh::Release()
 {
-    glDeleteBuffers(1, &VAO);
-    glDeleteBuffers(1, &positionsVBO);
-    glDeleteBuffers(1, &normalsVBO);
-    glDeleteBuffers(1, &texCoordsVBO);
-    glDeleteBuffers(1, &modelsVBO);
-    if (hasTangentsBitangents) {
-        glDeleteBuffers(1, &tangentsVBO);
-        glDeleteBuffers(1, &bitangentsVBO);
+    if (!isLoaded) {
+        return;
     }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &modelsVBO);
     glDeleteBuffers(1, &EBO);
     isLoaded = false;
 }
@@ -182,6 +152,28 @@ AABBOX Mesh::GetAABBOX(const bool inWorldSpace) const
     return result;
 }
 
+void setupInstanceAttributes(GLintptr offset)
+{
+    //model matrix
+    for (int i = 0; i < 4; ++i) {
+        glEnableVertexAttribArray(i + 5);
+        GL_CHECK_ERRORS;
+        glVertexAttribPointer(i + 5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)(offset + sizeof(GLfloat) * i * 4));
+        GL_CHECK_ERRORS;
+        glVertexAttribDivisor(i + 5, 1);
+        GL_CHECK_ERRORS;
+    }
+    //normal matrix
+    for (int i = 0; i < 3; ++i) {
+        glEnableVertexAttribArray(i + 9);
+        GL_CHECK_ERRORS;
+        glVertexAttribPointer(i + 9, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)(offset + sizeof(glm::mat4) + sizeof(GLfloat) * i * 3));
+        GL_CHECK_ERRORS;
+        glVertexAttribDivisor(i + 9, 1);
+        GL_CHECK_ERRORS;
+    }
+}
+
 std::unique_ptr<Mesh> createCube()
 {
     std::vector<float> cubeVerts = {
@@ -0,0 +1,227 @@
+#include "Models/MeshBuffer.h"
+#include "CpuProfiler.h"
+#include "RenderStats.h"
+#include "Models/VertexFormat.h"
+#include <algorithm>
+
+namespace {
+
+//meshlets transformed with model matrix of the only instance
+std::vector<Meshlet> toWorldSpace(const Mesh& mesh)
+{
+    std::vector<Meshlet> meshlets;
+    if (mesh.numberOfInstances() != 1) {
+        return meshlets;
+    }
+    glm::mat4 model = mesh.instanceModels.empty() ? mesh.model : mesh.instanceModels[0];
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    float maxScale = std::max(
+        glm::length(glm::vec3(model[0])),
+        std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    for (Meshlet meshlet : mesh.meshlets) {
+        meshlet.center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+        meshlet.radius *= maxScale;
+        if (meshlet.coneCutoff < 1.0f) {
+            meshlet.coneAxis = glm::normalize(normalMatrix * meshlet.coneAxis);
+        }
+        meshlets.push_back(meshlet);
+    }
+    return meshlets;
+}
+
+}
+
+void StaticMeshBuffer::GLLoad(
+    const std::vector<std::shared_ptr<Mesh>>& scene,
+    const std::vector<std::size_t>& meshIdx,
+    bool quantizePositions)
+{
+    PROFILE_SCOPE("StaticMeshBuffer::GLLoad");
+    if (isLoaded) {
+        Release();
+    }
+    quantizedPositions = quantizePositions;
+
+    //compute offsets of every mesh in shared buffers
+    std::uint32_t numVertices = 0;
+    std::uint32_t numIndices = 0;
+    std::uint32_t numInstances = 0;
+    std::uint32_t maxMeshVertices = 0;
+    for (std::size_t i : meshIdx) {
+        DrawElementsIndirectCommand range;
+        range.count = scene[i]->indices.size();
+        range.instanceCount = scene[i]->numberOfInstances();
+        range.firstIndex = numIndices;
+        range.baseVertex = numVertices;
+        range.baseInstance = numInstances;
+        meshes[i].range = range;
+        meshes[i].meshlets = toWorldSpace(*scene[i]);
+        numVertices += scene[i]->numberOfVertices();
+        numIndices += scene[i]->indices.size();
+        numInstances += scene[i]->numberOfInstances();
+        maxMeshVertices = std::max(maxMeshVertices, scene[i]->numberOfVertices());
+    }
+    //indices are relative to base vertex, so 16-bit indices work if every mesh fits them
+    indexType = indexTypeFor(maxMeshVertices);
+
+    //fill packed vertices, indices and per-draw instance data
+    std::vector<std::uint8_t> vertices;
+    vertices.reserve(numVertices * packedVertexSize(quantizePositions));
+    std::vector<std::uint8_t> indices;
+    indices.reserve(numIndices * indexSize(indexType));
+    std::vector<InstanceData> instances(numInstances);
+    for (std::size_t i : meshIdx) {
+        Mesh& mesh = *scene[i];
+        const DrawElementsIndirectCommand& range = meshes[i].range;
+        //dequantization is applied with model matrix from instance data
+        mesh.quantizePositions = quantizePositions;
+        mesh.positionDequantization = packVertices(mesh, quantizePositions, vertices);
+        packIndices(mesh.indices, indexType, indices);
+        std::vector<InstanceData> meshInstances = mesh.GetInstanceData();
+        std::copy(meshInstances.begin(), meshInstances.end(), instances.begin() + range.baseInstance);
+    }
+
+    //base instance in indirect commands needs OpenGL 4.3 (or ARB_multi_draw_indirect)
+    useIndirect = GLAD_GL_VERSION_4_3;
+    std::cout << "Static mesh buffer: " << meshIdx.size() << " meshes, " << numVertices << " vertices, "
+              << (indexType == GL_UNSIGNED_SHORT ? "16" : "32") << "-bit indices, "
+              << (useIndirect ? "multi-draw indirect" : "base vertex draw loop") << std::endl;
+
+    glGenVertexArrays(1, &VAO);
+    GL_CHECK_ERRORS;
+    glGenBuffers(1, &VBO);
+    GL_CHECK_ERRORS;
+    glGenBuffers(1, &EBO);
+    GL_CHECK_ERRORS;
+    glGenBuffers(1, &instancesVBO);
+    GL_CHECK_ERRORS;
+    glGenBuffers(1, &indirectBuffer);
+    GL_CHECK_ERRORS;
+
+    glBindVertexArray(VAO);
+    GL_CHECK_ERRORS;
+
+    //vertices
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+    GL_CHECK_ERRORS;
+    setupPackedVertexAttributes(quantizePositions);
+
+    //per-draw model and normal matrices, selected with base instance
+    glBindBuffer(GL_ARRAY_BUFFER, instancesVBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+    GL_CHECK_ERRORS;
+    setupInstanceAttributes();
+
+    //indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    GL_CHECK_ERRORS;
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
+    GL_CHECK_ERRORS;
+
+    glBindVertexArray(0);
+    GL_CHECK_ERRORS;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GL_CHECK_ERRORS;
+
+    isLoaded = true;
+}
+
+void StaticMeshBuffer::Draw(const std::vector<std::size_t>& meshIdx, const CullingView* view)
+{
+    if (!isLoaded || meshIdx.empty()) {
+        return;
+    }
+    commands.clear();
+    CullingStats ignoredStats;
+    CullingStats& stats = (view && view->stats) ? *view->stats : ignoredStats;
+    for (std::size_t i : meshIdx) {
+        const BufferedMesh& mesh = meshes.at(i);
+        if (view == nullptr || mesh.meshlets.empty()) {
+            commands.push_back(mesh.range);
+            continue;
+        }
+        //visible meshlets, adjacent ones are merged into one command
+        bool extendLast = false;
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            std::uint32_t* culledBy = nullptr;
+            if (!view->frustum.IntersectsSphere(meshlet.center, meshlet.radius)) {
+                culledBy = &stats.frustumCulled;
+            } else if (view->cullBackfacing && meshlet.IsBackfacing(view->position)) {
+                culledBy = &stats.backfaceCulled;
+            } else if (view->occlusion && view->occlusion->IsOccluded(meshlet.center, meshlet.radius)) {
+                culledBy = &stats.occlusionCulled;
+            }
+            if (culledBy) {
+                ++*culledBy;
+                extendLast = false;
+                continue;
+            }
+            ++stats.visible;
+            if (extendLast) {
+                commands.back().count += meshlet.count;
+            } else {
+                DrawElementsIndirectCommand command = mesh.range;
+                command.firstIndex += meshlet.firstIndex;
+                command.count = meshlet.count;
+                commands.push_back(command);
+                extendLast = true;
+            }
+        }
+    }
+    if (commands.empty()) {
+        return;
+    }
+
+    glBindVertexArray(VAO);
+    GL_CHECK_ERRORS;
+    if (useIndirect) {
+        //orphan previous commands so we don't wait for GPU
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr, commands.size(), 0);
+        GL_CHECK_ERRORS;
+        std::uint64_t triangles = 0;
+        std::uint64_t instances = 0;
+        for (const auto& command : commands) {
+            triangles += static_cast<std::uint64_t>(command.count / 3) * command.instanceCount;
+            instances += command.instanceCount;
+        }
+        RenderStats::AddIndirectDraw(triangles, instances);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        //without base instance we have to move instance attributes to the first instance of every draw
+        glBindBuffer(GL_ARRAY_BUFFER, instancesVBO);
+        for (const auto& command : commands) {
+            setupInstanceAttributes(command.baseInstance * sizeof(InstanceData));
+            glDrawElementsInstancedBaseVertex(
+                GL_TRIANGLES,
+                command.count,
+                indexType,
+                (GLvoid*)(command.firstIndex * indexSize(indexType)),
+                command.instanceCount,
+                command.baseVertex);
+            GL_CHECK_ERRORS;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+    GL_CHECK_ERRORS;
+}
+
+void StaticMeshBuffer::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &instancesVBO);
+    glDeleteBuffers(1, &indirectBuffer);
+    meshes.clear();
+    isLoaded = false;
+}
@@ -0,0 +1,475 @@
+#include "Models/MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+//Forsyth's scoring parameters, cache is simulated as LRU of this size
+const int kCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+//clusters smaller than this are merged with the previous one
+const std::size_t kMinClusterFaces = 16;
+
+float vertexScore(int cachePosition, std::uint32_t numActiveFaces)
+{
+    if (numActiveFaces == 0) {
+        //no triangles left to draw with this vertex
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            //vertex was used in the last triangle
+            score = kLastTriScore;
+        } else {
+            const float scaler = 1.0f / (kCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+        }
+    }
+    //bonus for vertices with few triangles left, so that lone triangles are not left behind
+    score += kValenceBoostScale * std::pow(static_cast<float>(numActiveFaces), -kValenceBoostPower);
+    return score;
+}
+
+//interleave lower 10 bits of value with two zero bits
+std::uint32_t spreadBits(std::uint32_t value)
+{
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+//order of clusters (faces [clusterStarts[c], clusterStarts[c + 1]) from firstIndex)
+//in which clusters facing outwards of the mesh are drawn first
+std::vector<std::size_t> sortClustersForOverdraw(
+    const std::vector<std::uint32_t>& indices,
+    const std::vector<glm::vec3>& positions,
+    std::size_t firstIndex,
+    const std::vector<std::size_t>& clusterStarts)
+{
+    const std::uint32_t* faceIndices = indices.data() + firstIndex;
+    const std::size_t numFaces = clusterStarts.back();
+
+    //area weighted centroid of the whole range
+    auto faceCentroid = [&](std::size_t f) {
+        return (positions[faceIndices[3 * f]] + positions[faceIndices[3 * f + 1]] + positions[faceIndices[3 * f + 2]]) / 3.0f;
+    };
+    auto faceNormal = [&](std::size_t f) {
+        const glm::vec3& p0 = positions[faceIndices[3 * f]];
+        return glm::cross(positions[faceIndices[3 * f + 1]] - p0, positions[faceIndices[3 * f + 2]] - p0);
+    };
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (std::size_t f = 0; f < numFaces; ++f) {
+        float area = glm::length(faceNormal(f));
+        meshCentroid += faceCentroid(f) * area;
+        meshArea += area;
+    }
+    std::size_t numClusters = clusterStarts.size() - 1;
+    std::vector<std::size_t> order(numClusters);
+    for (std::size_t c = 0; c < numClusters; ++c) {
+        order[c] = c;
+    }
+    if (meshArea == 0.0f) {
+        return order;
+    }
+    meshCentroid /= meshArea;
+
+    //clusters facing away from centroid are likely to occlude others, draw them first
+    std::vector<float> sortKeys(numClusters);
+    for (std::size_t c = 0; c < numClusters; ++c) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (std::size_t f = clusterStarts[c]; f < clusterStarts[c + 1]; ++f) {
+            glm::vec3 n = faceNormal(f);
+            float faceArea = glm::length(n);
+            centroid += faceCentroid(f) * faceArea;
+            normal += n;
+            area += faceArea;
+        }
+        if (area > 0.0f) {
+            centroid /= area;
+        }
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.0f) {
+            normal /= normalLength;
+        }
+        sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+    return order;
+}
+
+Meshlet computeMeshletBounds(const Mesh& mesh, std::uint32_t firstIndex, std::uint32_t count)
+{
+    Meshlet meshlet;
+    meshlet.firstIndex = firstIndex;
+    meshlet.count = count;
+
+    //sphere around center of bounding box
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+    for (std::uint32_t i = firstIndex; i < firstIndex + count; ++i) {
+        minPos = glm::min(minPos, mesh.positions[mesh.indices[i]]);
+        maxPos = glm::max(maxPos, mesh.positions[mesh.indices[i]]);
+    }
+    meshlet.center = 0.5f * (minPos + maxPos);
+    meshlet.radius = 0.0f;
+    for (std::uint32_t i = firstIndex; i < firstIndex + count; ++i) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(mesh.positions[mesh.indices[i]] - meshlet.center));
+    }
+
+    //cone containing all face normals
+    std::vector<glm::vec3> faceNormals;
+    glm::vec3 axis(0.0f);
+    for (std::uint32_t i = firstIndex; i + 2 < firstIndex + count; i += 3) {
+        const glm::vec3& p0 = mesh.positions[mesh.indices[i]];
+        glm::vec3 normal = glm::cross(mesh.positions[mesh.indices[i + 1]] - p0, mesh.positions[mesh.indices[i + 2]] - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            faceNormals.push_back(normal / length);
+            axis += faceNormals.back();
+        }
+    }
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (axisLength == 0.0f) {
+        return meshlet;
+    }
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (const auto& normal : faceNormals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    meshlet.coneAxis = axis;
+    if (minDot > 0.0f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+    return meshlet;
+}
+
+}
+
+std::uint64_t simulateVertexCache(
+    const std::vector<std::uint32_t>& indices,
+    std::uint32_t numVertices,
+    std::uint32_t cacheSize)
+{
+    //vertex is in FIFO cache if it was inserted less than cacheSize insertions ago
+    std::vector<std::uint64_t> insertedAt(numVertices, std::numeric_limits<std::uint64_t>::max());
+    std::uint64_t misses = 0;
+    for (std::uint32_t index : indices) {
+        if (insertedAt[index] == std::numeric_limits<std::uint64_t>::max() || misses - insertedAt[index] >= cacheSize) {
+            insertedAt[index] = misses;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+void optimizeVertexCache(
+    std::vector<std::uint32_t>& indices,
+    std::uint32_t numVertices,
+    std::size_t firstIndex,
+    std::size_t count)
+{
+    const std::size_t numFaces = count / 3;
+    if (numFaces == 0) {
+        return;
+    }
+    const std::uint32_t* faceIndices = indices.data() + firstIndex;
+
+    //vertex -> list of faces adjacency in CSR layout
+    std::vector<std::uint32_t> numActiveFaces(numVertices, 0);
+    for (std::size_t i = 0; i < numFaces * 3; ++i) {
+        ++numActiveFaces[faceIndices[i]];
+    }
+    std::vector<std::uint32_t> adjacencyOffsets(numVertices + 1, 0);
+    for (std::uint32_t v = 0; v < numVertices; ++v) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + numActiveFaces[v];
+    }
+    std::vector<std::uint32_t> adjacency(numFaces * 3);
+    {
+        std::vector<std::uint32_t> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (std::size_t i = 0; i < numFaces * 3; ++i) {
+            adjacency[filled[faceIndices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> scores(numVertices, 0.0f);
+    for (std::uint32_t v = 0; v < numVertices; ++v) {
+        scores[v] = vertexScore(-1, numActiveFaces[v]);
+    }
+    std::vector<float> faceScores(numFaces);
+    std::vector<bool> emitted(numFaces, false);
+    for (std::size_t f = 0; f < numFaces; ++f) {
+        faceScores[f] = scores[faceIndices[3 * f]] + scores[faceIndices[3 * f + 1]] + scores[faceIndices[3 * f + 2]];
+    }
+
+    std::vector<std::uint32_t> result;
+    result.reserve(numFaces * 3);
+    std::vector<std::uint32_t> cache;
+    std::vector<std::uint32_t> newCache;
+    cache.reserve(kCacheSize + 3);
+    newCache.reserve(kCacheSize + 3);
+    std::size_t scanPosition = 0; //faces before it are all emitted
+    std::size_t bestFace = 0;
+    for (std::size_t f = 1; f < numFaces; ++f) {
+        if (faceScores[f] > faceScores[bestFace]) {
+            bestFace = f;
+        }
+    }
+
+    for (std::size_t emittedCount = 0; emittedCount < numFaces; ++emittedCount) {
+        if (bestFace == numFaces) {
+            //no candidates in cache, take the first face left
+            while (emitted[scanPosition]) {
+                ++scanPosition;
+            }
+            bestFace = scanPosition;
+        }
+        emitted[bestFace] = true;
+
+        //put face vertices in front of LRU cache
+        newCache.clear();
+        for (int j = 0; j < 3; ++j) {
+            std::uint32_t v = faceIndices[3 * bestFace + j];
+            result.push_back(v);
+            newCache.push_back(v);
+
+            //remove face from vertex adjacency
+            std::uint32_t* begin = adjacency.data() + adjacencyOffsets[v];
+            std::uint32_t* end = begin + numActiveFaces[v];
+            std::uint32_t* it = std::find(begin, end, static_cast<std::uint32_t>(bestFace));
+            std::swap(*it, *(end - 1));
+            --numActiveFaces[v];
+        }
+        for (std::uint32_t v : cache) {
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+                newCache.push_back(v);
+            }
+        }
+        //vertices pushed out of cache lose cache score
+        for (std::size_t i = kCacheSize; i < newCache.size(); ++i) {
+            cachePosition[newCache[i]] = -1;
+            scores[newCache[i]] = vertexScore(-1, numActiveFaces[newCache[i]]);
+        }
+        newCache.resize(std::min<std::size_t>(newCache.size(), kCacheSize));
+        std::swap(cache, newCache);
+
+        //update scores of vertices in cache and pick best face adjacent to them
+        for (std::size_t i = 0; i < cache.size(); ++i) {
+            cachePosition[cache[i]] = i;
+            scores[cache[i]] = vertexScore(i, numActiveFaces[cache[i]]);
+        }
+        bestFace = numFaces;
+        float bestScore = -1.0f;
+        for (std::uint32_t v : cache) {
+            for (std::uint32_t k = 0; k < numActiveFaces[v]; ++k) {
+                std::uint32_t f = adjacency[adjacencyOffsets[v] + k];
+                float score = scores[faceIndices[3 * f]] + scores[faceIndices[3 * f + 1]] + scores[faceIndices[3 * f + 2]];
+                faceScores[f] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestFace = f;
+                }
+            }
+        }
+    }
+    std::copy(result.begin(), result.end(), indices.begin() + firstIndex);
+}
+
+void optimizeOverdraw(
+    std::vector<std::uint32_t>& indices,
+    const std::vector<glm::vec3>& positions,
+    std::size_t firstIndex,
+    std::size_t count)
+{
+    const std::size_t numFaces = count / 3;
+    if (numFaces < 2 * kMinClusterFaces) {
+        return;
+    }
+    const std::uint32_t* faceIndices = indices.data() + firstIndex;
+
+    //split at faces where all three vertices miss the cache, reordering clusters there costs almost nothing
+    std::vector<std::size_t> clusterStarts = { 0 };
+    std::vector<std::uint64_t> insertedAt(positions.size(), std::numeric_limits<std::uint64_t>::max());
+    std::uint64_t misses = 0;
+    for (std::size_t f = 0; f < numFaces; ++f) {
+        int faceMisses = 0;
+        for (int j = 0; j < 3; ++j) {
+            std::uint32_t v = faceIndices[3 * f + j];
+            if (insertedAt[v] == std::numeric_limits<std::uint64_t>::max() || misses - insertedAt[v] >= 16) {
+                insertedAt[v] = misses;
+                ++misses;
+                ++faceMisses;
+            }
+        }
+        if (faceMisses == 3 && f - clusterStarts.back() >= kMinClusterFaces) {
+            clusterStarts.push_back(f);
+        }
+    }
+    if (clusterStarts.size() < 2) {
+        return;
+    }
+    clusterStarts.push_back(numFaces);
+
+    std::vector<std::size_t> order = sortClustersForOverdraw(indices, positions, firstIndex, clusterStarts);
+    std::vector<std::uint32_t> result;
+    result.reserve(numFaces * 3);
+    for (std::size_t c : order) {
+        result.insert(result.end(), faceIndices + 3 * clusterStarts[c], faceIndices + 3 * clusterStarts[c + 1]);
+    }
+    std::copy(result.begin(), result.end(), indices.begin() + firstIndex);
+}
+
+void optimizeVertexFetch(Mesh& mesh)
+{
+    const std::uint32_t unused = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> remap(mesh.numberOfVertices(), unused);
+    std::uint32_t nextVertex = 0;
+    for (std::uint32_t& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = nextVertex++;
+        }
+        index = remap[index];
+    }
+    //keep unreferenced vertices at the end
+    for (std::uint32_t& newIndex : remap) {
+        if (newIndex == unused) {
+            newIndex = nextVertex++;
+        }
+    }
+
+    auto permute = [&remap](auto& attribute) {
+        if (attribute.size() != remap.size()) {
+            return;
+        }
+        auto reordered = attribute;
+        for (std::size_t i = 0; i < remap.size(); ++i) {
+            reordered[remap[i]] = attribute[i];
+        }
+        attribute.swap(reordered);
+    };
+    permute(mesh.positions);
+    permute(mesh.normals);
+    permute(mesh.texCoords);
+    permute(mesh.tangents);
+    permute(mesh.bitangents);
+}
+
+OptimizationStats buildMeshlets(Mesh& mesh, std::uint32_t maxFaces)
+{
+    mesh.meshlets.clear();
+    OptimizationStats stats;
+    std::uint32_t numFaces = mesh.numberOfFaces();
+    stats.numFaces = numFaces;
+    stats.missesBefore = simulateVertexCache(mesh.indices, mesh.numberOfVertices());
+    if (numFaces == 0 || maxFaces == 0) {
+        stats.missesAfter = stats.missesBefore;
+        return stats;
+    }
+
+    //sort triangles along Z-order curve inside bounding box
+    AABBOX bbox = mesh.GetAABBOX(false);
+    glm::vec3 extent = glm::max(bbox.max - bbox.min, glm::vec3(1e-6f));
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> codes(numFaces); //code, face
+    for (std::uint32_t f = 0; f < numFaces; ++f) {
+        glm::vec3 center = (mesh.positions[mesh.indices[3 * f]]
+                               + mesh.positions[mesh.indices[3 * f + 1]]
+                               + mesh.positions[mesh.indices[3 * f + 2]])
+            / 3.0f;
+        glm::vec3 cell = glm::clamp((center - bbox.min) / extent, 0.0f, 1.0f) * 1023.0f;
+        codes[f].first = spreadBits(static_cast<std::uint32_t>(cell.x))
+            | (spreadBits(static_cast<std::uint32_t>(cell.y)) << 1)
+            | (spreadBits(static_cast<std::uint32_t>(cell.z)) << 2);
+        codes[f].second = f;
+    }
+    std::stable_sort(codes.begin(), codes.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+    std::vector<std::uint32_t> indices(mesh.indices.size());
+    for (std::uint32_t f = 0; f < numFaces; ++f) {
+        for (std::uint32_t j = 0; j < 3; ++j) {
+            indices[3 * f + j] = mesh.indices[3 * codes[f].second + j];
+        }
+    }
+    mesh.indices.swap(indices);
+
+    //cut sorted triangles into meshlets, triangles inside every meshlet are free to reorder
+    std::vector<std::size_t> meshletStarts;
+    for (std::uint32_t first = 0; first < numFaces; first += maxFaces) {
+        meshletStarts.push_back(first);
+    }
+    meshletStarts.push_back(numFaces);
+
+    //optimize every meshlet for vertex cache on its own local vertices,
+    //so cost doesn't depend on number of vertices in the whole mesh
+    const std::uint32_t unused = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> toLocal(mesh.numberOfVertices(), unused);
+    std::vector<std::uint32_t> toGlobal;
+    std::vector<std::uint32_t> localIndices;
+    for (std::size_t m = 0; m + 1 < meshletStarts.size(); ++m) {
+        std::size_t firstIndex = meshletStarts[m] * 3;
+        std::size_t count = (meshletStarts[m + 1] - meshletStarts[m]) * 3;
+        toGlobal.clear();
+        localIndices.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::uint32_t& local = toLocal[mesh.indices[firstIndex + i]];
+            if (local == unused) {
+                local = toGlobal.size();
+                toGlobal.push_back(mesh.indices[firstIndex + i]);
+            }
+            localIndices[i] = local;
+        }
+        optimizeVertexCache(localIndices, toGlobal.size(), 0, count);
+        for (std::size_t i = 0; i < count; ++i) {
+            mesh.indices[firstIndex + i] = toGlobal[localIndices[i]];
+        }
+        for (std::uint32_t v : toGlobal) {
+            toLocal[v] = unused;
+        }
+    }
+
+    //meshlets are clusters for overdraw optimization, so spatial sort doesn't discard it
+    std::vector<std::size_t> order = sortClustersForOverdraw(mesh.indices, mesh.positions, 0, meshletStarts);
+    indices.clear();
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges; //first index, count
+    for (std::size_t m : order) {
+        ranges.emplace_back(indices.size(), (meshletStarts[m + 1] - meshletStarts[m]) * 3);
+        indices.insert(indices.end(), mesh.indices.begin() + meshletStarts[m] * 3, mesh.indices.begin() + meshletStarts[m + 1] * 3);
+    }
+    mesh.indices.swap(indices);
+
+    optimizeVertexFetch(mesh);
+    for (const auto& range : ranges) {
+        mesh.meshlets.push_back(computeMeshletBounds(mesh, range.first, range.second));
+    }
+    stats.missesAfter = simulateVertexCache(mesh.indices, mesh.numberOfVertices());
+    return stats;
+}
+
+OptimizationStats optimizeMesh(Mesh& mesh)
+{
+    OptimizationStats stats;
+    stats.numFaces = mesh.numberOfFaces();
+    stats.missesBefore = simulateVertexCache(mesh.indices, mesh.numberOfVertices());
+    optimizeVertexCache(mesh.indices, mesh.numberOfVertices(), 0, mesh.indices.size());
+    optimizeOverdraw(mesh.indices, mesh.positions, 0, mesh.indices.size());
+    optimizeVertexFetch(mesh);
+    stats.missesAfter = simulateVertexCache(mesh.indices, mesh.numberOfVertices());
+    return stats;
+}
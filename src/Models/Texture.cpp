@@ -1,9 +1,11 @@
 #include "Models/Texture.h"
+#include "CpuProfiler.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 Texture::pointerType Texture::loadImg(const std::string& path)
 {
+    PROFILE_SCOPE("texture decode");
     stbi_uc* img = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
     if (img == nullptr) {
         throw std::runtime_error("Couldn't load image " + path);
@@ -22,6 +24,7 @@ void Texture::GLBind() const
 
 void Texture::GLLoad()
 {
+    PROFILE_SCOPE("Texture::GLLoad");
     if (textureID) {
         Release();
     }
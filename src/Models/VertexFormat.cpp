@@ -0,0 +1,176 @@
+#include "Models/VertexFormat.h"
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+std::int16_t toSnorm16(float value)
+{
+    return static_cast<std::int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+std::uint16_t toUnorm16(float value)
+{
+    return static_cast<std::uint16_t>(std::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+//map unit vector to [-1, 1]^2 (octahedral encoding)
+glm::vec2 octEncode(glm::vec3 v)
+{
+    float norm = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (norm == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+    v /= norm;
+    glm::vec2 e(v.x, v.y);
+    if (v.z < 0.0f) {
+        e = glm::vec2(
+            (1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e;
+}
+
+template <typename T>
+void write(std::uint8_t* dst, const T* values, std::size_t count)
+{
+    std::memcpy(dst, values, sizeof(T) * count);
+}
+
+}
+
+std::size_t packedVertexSize(bool quantizedPositions)
+{
+    return (quantizedPositions ? 4 * sizeof(std::uint16_t) : 3 * sizeof(float)) + 8 * sizeof(std::uint16_t);
+}
+
+glm::mat4 packVertices(
+    const Mesh& mesh,
+    bool quantizePositions,
+    std::vector<std::uint8_t>& data)
+{
+    std::size_t stride = packedVertexSize(quantizePositions);
+    std::size_t positionSize = stride - 8 * sizeof(std::uint16_t);
+    std::size_t start = data.size();
+    data.resize(start + stride * mesh.numberOfVertices());
+
+    glm::mat4 dequantization(1.0f);
+    glm::vec3 bboxMin(0.0f);
+    glm::vec3 bboxSize(1.0f);
+    if (quantizePositions) {
+        AABBOX bbox = mesh.GetAABBOX(false);
+        bboxMin = bbox.min;
+        bboxSize = glm::max(bbox.max - bbox.min, glm::vec3(1e-6f));
+        dequantization = glm::translate(dequantization, bboxMin);
+        dequantization = glm::scale(dequantization, bboxSize);
+    }
+
+    //texture coordinates repeat, so shift by whole number to keep half floats precise
+    glm::vec2 texCoordsShift(0.0f);
+    if (!mesh.texCoords.empty()) {
+        glm::vec2 texMin = mesh.texCoords[0];
+        glm::vec2 texMax = mesh.texCoords[0];
+        for (const auto& texCoords : mesh.texCoords) {
+            texMin = glm::min(texMin, texCoords);
+            texMax = glm::max(texMax, texCoords);
+        }
+        texCoordsShift = glm::floor((texMin + texMax) * 0.5f);
+    }
+
+    for (std::uint32_t i = 0; i < mesh.numberOfVertices(); ++i) {
+        std::uint8_t* vertex = data.data() + start + i * stride;
+
+        //position
+        if (quantizePositions) {
+            glm::vec3 pos = (mesh.positions[i] - bboxMin) / bboxSize;
+            std::uint16_t packed[4] = { toUnorm16(pos.x), toUnorm16(pos.y), toUnorm16(pos.z), 0 };
+            write(vertex, packed, 4);
+        } else {
+            write(vertex, &mesh.positions[i].x, 3);
+        }
+
+        //normal
+        glm::vec3 normal = mesh.normals[i];
+        glm::vec2 normalOct = octEncode(normal);
+        std::int16_t packedNormal[2] = { toSnorm16(normalOct.x), toSnorm16(normalOct.y) };
+        write(vertex + positionSize, packedNormal, 2);
+
+        //tangent and bitangent sign (bitangent = sign * cross(normal, tangent))
+        glm::vec3 tangent(1.0f, 0.0f, 0.0f);
+        float bitangentSign = 1.0f;
+        if (mesh.hasTangentsBitangents) {
+            tangent = mesh.tangents[i];
+            if (glm::dot(glm::cross(normal, tangent), mesh.bitangents[i]) < 0.0f) {
+                bitangentSign = -1.0f;
+            }
+        }
+        glm::vec2 tangentOct = octEncode(tangent);
+        std::int16_t packedTangent[4] = { toSnorm16(tangentOct.x), toSnorm16(tangentOct.y), toSnorm16(bitangentSign), 0 };
+        write(vertex + positionSize + 2 * sizeof(std::int16_t), packedTangent, 4);
+
+        //texture coordinates
+        glm::vec2 texCoords = mesh.texCoords[i] - texCoordsShift;
+        std::uint16_t packedTexCoords[2] = { glm::packHalf1x16(texCoords.x), glm::packHalf1x16(texCoords.y) };
+        write(vertex + positionSize + 6 * sizeof(std::int16_t), packedTexCoords, 2);
+    }
+    return dequantization;
+}
+
+void setupPackedVertexAttributes(bool quantizedPositions)
+{
+    GLsizei stride = packedVertexSize(quantizedPositions);
+    std::size_t positionSize = stride - 8 * sizeof(std::uint16_t);
+    //positions
+    glEnableVertexAttribArray(0);
+    GL_CHECK_ERRORS;
+    if (quantizedPositions) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (GLvoid*)0);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+    }
+    GL_CHECK_ERRORS;
+    //normals
+    glEnableVertexAttribArray(1);
+    GL_CHECK_ERRORS;
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)positionSize);
+    GL_CHECK_ERRORS;
+    //texture coordinates
+    glEnableVertexAttribArray(2);
+    GL_CHECK_ERRORS;
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)(positionSize + 6 * sizeof(std::int16_t)));
+    GL_CHECK_ERRORS;
+    //tangents with bitangent sign
+    glEnableVertexAttribArray(3);
+    GL_CHECK_ERRORS;
+    glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, stride, (GLvoid*)(positionSize + 2 * sizeof(std::int16_t)));
+    GL_CHECK_ERRORS;
+}
+
+GLenum indexTypeFor(std::uint32_t numVertices)
+{
+    return numVertices <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::size_t indexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+}
+
+void packIndices(
+    const std::vector<std::uint32_t>& indices,
+    GLenum indexType,
+    std::vector<std::uint8_t>& data)
+{
+    std::size_t offset = data.size();
+    data.resize(offset + indices.size() * indexSize(indexType));
+    if (indexType == GL_UNSIGNED_SHORT) {
+        for (std::uint32_t index : indices) {
+            std::uint16_t shortIndex = static_cast<std::uint16_t>(index);
+            std::memcpy(data.data() + offset, &shortIndex, sizeof(shortIndex));
+            offset += sizeof(shortIndex);
+        }
+    } else {
+        std::memcpy(data.data() + offset, indices.data(), indices.size() * sizeof(std::uint32_t));
+    }
+}
@@ -0,0 +1,178 @@
+#include "MomentShadowMap.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+//taps per pass of summed-area table, table of n texels takes log4(n) passes per axis
+const int kSatTaps = 4;
+
+//box filter of summed-area table in texels (lighting.glsl widens it for minified shadow map)
+const float kSatKernel = 6.0f;
+
+}
+
+MomentFilter MomentShadowMap::FilterFromString(const std::string& name)
+{
+    if (name == "vsm") {
+        return MomentFilter::VSM;
+    }
+    if (name == "evsm") {
+        return MomentFilter::EVSM;
+    }
+    if (name == "sat") {
+        return MomentFilter::SAT;
+    }
+    throw std::runtime_error("Unknown shadow filter " + name);
+}
+
+void MomentShadowMap::Setup(std::uint32_t depthWidth, std::uint32_t depthHeight, MomentFilter filter_, int bits_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    filter = filter_;
+    bits = filter == MomentFilter::SAT ? 32 : bits_;
+    width = std::max(1u, depthWidth / 2);
+    height = std::max(1u, depthHeight / 2);
+    //SAT is sampled with box of any size, so it doesn't need mipmaps
+    numLevels = filter == MomentFilter::SAT
+        ? 1
+        : 1 + static_cast<int>(std::floor(std::log2(std::max(width, height))));
+    //exp(c * d)^2 has to fit into half float (65504), float allows much steeper warp
+    evsmExponents = bits == 16 ? glm::vec2(5.54f, 5.54f) : glm::vec2(40.0f, 5.0f);
+    minVariance = bits == 16 ? 0.00002f : 0.000001f;
+
+    GLenum internalFormat;
+    if (filter == MomentFilter::EVSM) {
+        internalFormat = bits == 16 ? GL_RGBA16F : GL_RGBA32F;
+    } else {
+        internalFormat = bits == 16 ? GL_RG16F : GL_RG32F;
+    }
+    glGenTextures(2, textures);
+    GL_CHECK_ERRORS;
+    for (int i = 0; i < 2; ++i) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        GL_CHECK_ERRORS;
+        //only the texture with final result needs mip chain
+        int levels = i == 0 ? numLevels : 1;
+        for (int level = 0; level < levels; ++level) {
+            glTexImage2D(GL_TEXTURE_2D, level, internalFormat,
+                std::max(1u, width >> level), std::max(1u, height >> level), 0, GL_RGBA, GL_FLOAT, nullptr);
+            GL_CHECK_ERRORS;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        //lighting.glsl treats everything outside of shadow map as lit
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        GL_CHECK_ERRORS;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[0], 0);
+    GL_CHECK_ERRORS;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    result = 0;
+    isLoaded = true;
+}
+
+void MomentShadowMap::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(2, textures);
+    GL_CHECK_ERRORS;
+    isLoaded = false;
+}
+
+void MomentShadowMap::drawPass(ShaderProgram& program, GLuint source, GLuint target)
+{
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    program.SetUniform("sourceBuffer", 0);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+    GL_CHECK_ERRORS;
+}
+
+void MomentShadowMap::Build(GLuint depthTexture, ShaderProgram& program, GLuint quadVAO)
+{
+    if (!isLoaded) {
+        return;
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(program.ProgramObj);
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE0);
+    program.SetUniform("filterMode", static_cast<int>(filter));
+    program.SetUniform("evsmExponents", evsmExponents);
+
+    //depth texture is read without comparison, its sampler is restored afterwards
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    program.SetUniform("pass", 0);
+    drawPass(program, depthTexture, textures[0]);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+
+    if (filter == MomentFilter::SAT) {
+        //prefix sums along x, then along y, every pass adds kSatTaps texels step apart
+        program.SetUniform("pass", 2);
+        result = 0;
+        for (int axis = 0; axis < 2; ++axis) {
+            program.SetUniform("direction", axis == 1);
+            std::uint32_t size = axis == 0 ? width : height;
+            for (std::uint32_t step = 1; step < size; step *= kSatTaps) {
+                program.SetUniform("satStep", static_cast<int>(step));
+                drawPass(program, textures[result], textures[1 - result]);
+                result = 1 - result;
+            }
+        }
+    } else {
+        //separable Gaussian at half resolution, then mipmaps for minified lookups
+        program.SetUniform("pass", 1);
+        program.SetUniform("direction", false);
+        drawPass(program, textures[0], textures[1]);
+        program.SetUniform("direction", true);
+        drawPass(program, textures[1], textures[0]);
+        result = 0;
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        GL_CHECK_ERRORS;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    GL_CHECK_ERRORS;
+}
+
+void MomentShadowMap::Bind(ShaderProgram& program, int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, isLoaded ? textures[result] : 0);
+    GL_CHECK_ERRORS;
+    program.SetUniform("dirLight.shadowMap", unit);
+    program.SetUniform("evsmExponents", evsmExponents);
+    program.SetUniform("momentsMinVariance", minVariance);
+    program.SetUniform("satKernel", kSatKernel);
+}
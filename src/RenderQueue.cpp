@@ -0,0 +1,32 @@
+#include "RenderQueue.h"
+#include <array>
+
+void RenderQueue::Sort()
+{
+    if (keys.size() < 2) {
+        return;
+    }
+    scratch.resize(keys.size());
+    std::array<std::size_t, 256> counts;
+    for (std::uint32_t shift = 0; shift < 64; shift += 8) {
+        counts.fill(0);
+        for (std::uint64_t key : keys) {
+            ++counts[(key >> shift) & 0xFF];
+        }
+        //all keys have the same digit, nothing to do for this pass
+        if (counts[(keys[0] >> shift) & 0xFF] == keys.size()) {
+            continue;
+        }
+        //prefix sums give the first position for every digit
+        std::size_t offset = 0;
+        for (std::size_t& count : counts) {
+            std::size_t tmp = count;
+            count = offset;
+            offset += tmp;
+        }
+        for (std::uint64_t key : keys) {
+            scratch[counts[(key >> shift) & 0xFF]++] = key;
+        }
+        keys.swap(scratch);
+    }
+}
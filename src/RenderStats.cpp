@@ -0,0 +1,293 @@
+#include "RenderStats.h"
+#include <iomanip>
+
+namespace {
+
+std::vector<std::pair<std::string, PassStats>> currentFrame;
+std::vector<std::pair<std::string, PassStats>> lastFrame;
+std::size_t currentPass = 0;
+
+//calls before the first pass of frame
+PassStats& counters()
+{
+    if (currentFrame.empty()) {
+        currentFrame.emplace_back("other", PassStats());
+        currentPass = 0;
+    }
+    return currentFrame[currentPass].second;
+}
+
+//functions loaded by glad
+PFNGLDRAWELEMENTSPROC realDrawElements;
+PFNGLDRAWELEMENTSINSTANCEDPROC realDrawElementsInstanced;
+PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC realDrawElementsInstancedBaseVertex;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC realMultiDrawElementsIndirect;
+PFNGLUSEPROGRAMPROC realUseProgram;
+PFNGLBINDTEXTUREPROC realBindTexture;
+PFNGLBINDFRAMEBUFFERPROC realBindFramebuffer;
+PFNGLBUFFERDATAPROC realBufferData;
+PFNGLBUFFERSUBDATAPROC realBufferSubData;
+PFNGLUNIFORM1IPROC realUniform1i;
+PFNGLUNIFORM1UIPROC realUniform1ui;
+PFNGLUNIFORM1FPROC realUniform1f;
+PFNGLUNIFORM1DPROC realUniform1d;
+PFNGLUNIFORM2FVPROC realUniform2fv;
+PFNGLUNIFORM3FVPROC realUniform3fv;
+PFNGLUNIFORM4FVPROC realUniform4fv;
+PFNGLUNIFORMMATRIX3FVPROC realUniformMatrix3fv;
+PFNGLUNIFORMMATRIX4FVPROC realUniformMatrix4fv;
+
+void APIENTRY countDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    PassStats& stats = counters();
+    ++stats.drawCalls;
+    stats.triangles += mode == GL_TRIANGLES ? count / 3 : 0;
+    ++stats.instances;
+    realDrawElements(mode, count, type, indices);
+}
+
+void APIENTRY countDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount)
+{
+    PassStats& stats = counters();
+    ++stats.drawCalls;
+    stats.triangles += mode == GL_TRIANGLES ? static_cast<std::uint64_t>(count / 3) * instanceCount : 0;
+    stats.instances += instanceCount;
+    realDrawElementsInstanced(mode, count, type, indices, instanceCount);
+}
+
+void APIENTRY countDrawElementsInstancedBaseVertex(
+    GLenum mode,
+    GLsizei count,
+    GLenum type,
+    const void* indices,
+    GLsizei instanceCount,
+    GLint baseVertex)
+{
+    PassStats& stats = counters();
+    ++stats.drawCalls;
+    stats.triangles += mode == GL_TRIANGLES ? static_cast<std::uint64_t>(count / 3) * instanceCount : 0;
+    stats.instances += instanceCount;
+    realDrawElementsInstancedBaseVertex(mode, count, type, indices, instanceCount, baseVertex);
+}
+
+void APIENTRY countMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride)
+{
+    //triangles and instances are reported by caller
+    ++counters().drawCalls;
+    realMultiDrawElementsIndirect(mode, type, indirect, drawCount, stride);
+}
+
+void APIENTRY countUseProgram(GLuint program)
+{
+    ++counters().programBinds;
+    realUseProgram(program);
+}
+
+void APIENTRY countBindTexture(GLenum target, GLuint texture)
+{
+    ++counters().textureBinds;
+    realBindTexture(target, texture);
+}
+
+void APIENTRY countBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    ++counters().framebufferBinds;
+    realBindFramebuffer(target, framebuffer);
+}
+
+void APIENTRY countBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    //orphaning without data doesn't upload anything
+    counters().bytesUploaded += data != nullptr ? size : 0;
+    realBufferData(target, size, data, usage);
+}
+
+void APIENTRY countBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    counters().bytesUploaded += size;
+    realBufferSubData(target, offset, size, data);
+}
+
+void APIENTRY countUniform1i(GLint location, GLint v0)
+{
+    ++counters().uniformUploads;
+    realUniform1i(location, v0);
+}
+
+void APIENTRY countUniform1ui(GLint location, GLuint v0)
+{
+    ++counters().uniformUploads;
+    realUniform1ui(location, v0);
+}
+
+void APIENTRY countUniform1f(GLint location, GLfloat v0)
+{
+    ++counters().uniformUploads;
+    realUniform1f(location, v0);
+}
+
+void APIENTRY countUniform1d(GLint location, GLdouble x)
+{
+    ++counters().uniformUploads;
+    realUniform1d(location, x);
+}
+
+void APIENTRY countUniform2fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    ++counters().uniformUploads;
+    realUniform2fv(location, count, value);
+}
+
+void APIENTRY countUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    ++counters().uniformUploads;
+    realUniform3fv(location, count, value);
+}
+
+void APIENTRY countUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    ++counters().uniformUploads;
+    realUniform4fv(location, count, value);
+}
+
+void APIENTRY countUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+    ++counters().uniformUploads;
+    realUniformMatrix3fv(location, count, transpose, value);
+}
+
+void APIENTRY countUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+    ++counters().uniformUploads;
+    realUniformMatrix4fv(location, count, transpose, value);
+}
+
+//replace function if driver has it
+template <typename T>
+void hook(T& glad, T& real, T counting)
+{
+    if (glad != nullptr && glad != counting) {
+        real = glad;
+        glad = counting;
+    }
+}
+
+}
+
+PassStats& PassStats::operator+=(const PassStats& other)
+{
+    drawCalls += other.drawCalls;
+    triangles += other.triangles;
+    instances += other.instances;
+    programBinds += other.programBinds;
+    textureBinds += other.textureBinds;
+    uniformUploads += other.uniformUploads;
+    bytesUploaded += other.bytesUploaded;
+    framebufferBinds += other.framebufferBinds;
+    return *this;
+}
+
+void RenderStats::Install()
+{
+    hook(glad_glDrawElements, realDrawElements, countDrawElements);
+    hook(glad_glDrawElementsInstanced, realDrawElementsInstanced, countDrawElementsInstanced);
+    hook(glad_glDrawElementsInstancedBaseVertex, realDrawElementsInstancedBaseVertex, countDrawElementsInstancedBaseVertex);
+    hook(glad_glMultiDrawElementsIndirect, realMultiDrawElementsIndirect, countMultiDrawElementsIndirect);
+    hook(glad_glUseProgram, realUseProgram, countUseProgram);
+    hook(glad_glBindTexture, realBindTexture, countBindTexture);
+    hook(glad_glBindFramebuffer, realBindFramebuffer, countBindFramebuffer);
+    hook(glad_glBufferData, realBufferData, countBufferData);
+    hook(glad_glBufferSubData, realBufferSubData, countBufferSubData);
+    hook(glad_glUniform1i, realUniform1i, countUniform1i);
+    hook(glad_glUniform1ui, realUniform1ui, countUniform1ui);
+    hook(glad_glUniform1f, realUniform1f, countUniform1f);
+    hook(glad_glUniform1d, realUniform1d, countUniform1d);
+    hook(glad_glUniform2fv, realUniform2fv, countUniform2fv);
+    hook(glad_glUniform3fv, realUniform3fv, countUniform3fv);
+    hook(glad_glUniform4fv, realUniform4fv, countUniform4fv);
+    hook(glad_glUniformMatrix3fv, realUniformMatrix3fv, countUniformMatrix3fv);
+    hook(glad_glUniformMatrix4fv, realUniformMatrix4fv, countUniformMatrix4fv);
+}
+
+void RenderStats::SetPass(const std::string& name)
+{
+    for (std::size_t i = 0; i < currentFrame.size(); ++i) {
+        if (currentFrame[i].first == name) {
+            currentPass = i;
+            return;
+        }
+    }
+    currentFrame.emplace_back(name, PassStats());
+    currentPass = currentFrame.size() - 1;
+}
+
+void RenderStats::AddIndirectDraw(std::uint64_t triangles, std::uint64_t instances)
+{
+    PassStats& stats = counters();
+    stats.triangles += triangles;
+    stats.instances += instances;
+}
+
+void RenderStats::EndFrame()
+{
+    lastFrame.swap(currentFrame);
+    currentFrame.clear();
+    currentPass = 0;
+}
+
+const std::vector<std::pair<std::string, PassStats>>& RenderStats::GetLastFrame()
+{
+    return lastFrame;
+}
+
+PassStats RenderStats::GetLastFrameTotal()
+{
+    PassStats total;
+    for (const auto& pass : lastFrame) {
+        total += pass.second;
+    }
+    return total;
+}
+
+void RenderStats::Print(std::ostream& out)
+{
+    auto printRow = [&](const std::string& name, const PassStats& stats) {
+        out << std::left << std::setw(24) << name << std::right
+            << std::setw(8) << stats.drawCalls
+            << std::setw(11) << stats.triangles
+            << std::setw(10) << stats.instances
+            << std::setw(10) << stats.programBinds
+            << std::setw(10) << stats.textureBinds
+            << std::setw(10) << stats.uniformUploads
+            << std::setw(12) << stats.bytesUploaded
+            << std::setw(6) << stats.framebufferBinds << "\n";
+    };
+    out << std::left << std::setw(24) << "pass" << std::right
+        << std::setw(8) << "draws"
+        << std::setw(11) << "triangles"
+        << std::setw(10) << "instances"
+        << std::setw(10) << "programs"
+        << std::setw(10) << "textures"
+        << std::setw(10) << "uniforms"
+        << std::setw(12) << "bytes"
+        << std::setw(6) << "fbos" << "\n";
+    for (const auto& pass : lastFrame) {
+        printRow(pass.first, pass.second);
+    }
+    printRow("total", GetLastFrameTotal());
+    out << std::flush;
+}
+
+void RenderStats::WriteCSV(std::ostream& out, std::uint64_t frame)
+{
+    if (frame == 0) {
+        out << "frame,pass,draws,triangles,instances,programs,textures,uniforms,bytes,fbos\n";
+    }
+    for (const auto& pass : lastFrame) {
+        const PassStats& stats = pass.second;
+        out << frame << "," << pass.first << ","
+            << stats.drawCalls << "," << stats.triangles << "," << stats.instances << ","
+            << stats.programBinds << "," << stats.textureBinds << "," << stats.uniformUploads << ","
+            << stats.bytesUploaded << "," << stats.framebufferBinds << "\n";
+    }
+}
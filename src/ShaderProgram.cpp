@@ -107,16 +107,46 @@ bool ShaderProgram::reLink()
     return true;
 }
 
-GLuint ShaderProgram::LoadShaderObject(GLenum type, const std::string& filename)
+namespace {
+
+//read shader source replacing lines #include "file" with contents of file (path relative to including file)
+bool readShaderSource(const std::string& filename, std::string& source, int depth = 0)
 {
     std::ifstream fs(filename);
-
-    if (!fs.is_open()) {
+    if (!fs.is_open() || depth > 16) {
         std::cerr << "ERROR: Could not read shader from " << filename << std::endl;
-        return 0;
+        return false;
+    }
+    std::string directory = filename.substr(0, filename.find_last_of('/') + 1);
+    const std::string directive = "#include";
+    std::string line;
+    while (std::getline(fs, line)) {
+        std::size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, directive.size(), directive) == 0) {
+            std::size_t open = line.find('"', start + directive.size());
+            std::size_t close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos) {
+                std::cerr << "ERROR: Invalid include in " << filename << ": " << line << std::endl;
+                return false;
+            }
+            if (!readShaderSource(directory + line.substr(open + 1, close - open - 1), source, depth + 1)) {
+                return false;
+            }
+            continue;
+        }
+        source += line + "\n";
     }
+    return true;
+}
 
-    std::string shaderText((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+}
+
+GLuint ShaderProgram::LoadShaderObject(GLenum type, const std::string& filename)
+{
+    std::string shaderText;
+    if (!readShaderSource(filename, shaderText)) {
+        return 0;
+    }
 
     GLuint newShaderObject = glCreateShader(type);
 
@@ -209,6 +239,16 @@ void ShaderProgram::SetUniform(const std::string& location, const glm::mat4& val
     glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(value));
 }
 
+void ShaderProgram::SetUniform(const std::string& location, const glm::vec2& value) const
+{
+    GLint uniformLocation = glGetUniformLocation(ProgramObj, location.c_str());
+    if (uniformLocation == -1) {
+        std::cerr << "Uniform " << location << " not found" << std::endl;
+        return;
+    }
+    glUniform2fv(uniformLocation, 1, glm::value_ptr(value));
+}
+
 void ShaderProgram::SetUniform(const std::string& location, const glm::vec3& value) const
 {
     GLint uniformLocation = glGetUniformLocation(ProgramObj, location.c_str());
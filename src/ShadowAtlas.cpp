@@ -0,0 +1,298 @@
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <numeric>
+
+namespace {
+
+//view directions and up vectors of cube faces
+const glm::vec3 kFaceForward[6] = {
+    glm::vec3(1.0f, 0.0f, 0.0f),
+    glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(0.0f, 0.0f, -1.0f)
+};
+const glm::vec3 kFaceUp[6] = {
+    glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(0.0f, 0.0f, -1.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f)
+};
+
+//resolution changes only when size on screen is off by more than this (in log2 units)
+const float kResolutionHysteresis = 0.75f;
+
+std::uint32_t floorPow2(float value)
+{
+    return 1u << static_cast<std::uint32_t>(std::max(0.0f, std::floor(std::log2(value))));
+}
+
+}
+
+void ShadowAtlas::Setup(
+    std::uint32_t size,
+    std::uint32_t numLights,
+    std::uint32_t minResolution_,
+    std::uint32_t maxResolution_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    width = size * 3 / 2;
+    height = size;
+    minResolution = minResolution_;
+    maxResolution = maxResolution_;
+    tiles = std::vector<LightTiles>(numLights);
+    roundRobin = 0;
+
+    glGenTextures(1, &depthTexture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    GL_CHECK_ERRORS;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    GL_CHECK_ERRORS;
+    //hardware PCF, lookups are clamped to tiles in shader
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    GL_CHECK_ERRORS;
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    isLoaded = true;
+}
+
+void ShadowAtlas::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteTextures(1, &depthTexture);
+    GL_CHECK_ERRORS;
+    glDeleteFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    isLoaded = false;
+}
+
+bool ShadowAtlas::pack(const std::vector<std::uint32_t>& resolutions, std::vector<LightTiles>& result) const
+{
+    bool allFit = true;
+    result = std::vector<LightTiles>(tiles.size());
+    struct Shelf {
+        std::uint32_t y;
+        std::uint32_t height;
+        std::uint32_t used;
+    };
+    std::vector<Shelf> shelves;
+    std::uint32_t top = 0;
+
+    //largest blocks first, so shelves are filled tightly
+    std::vector<std::uint32_t> order(tiles.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+        return resolutions[a] > resolutions[b];
+    });
+    for (std::uint32_t i : order) {
+        LightTiles& newTiles = result[i];
+        for (std::uint32_t res = resolutions[i]; res >= minResolution && newTiles.resolution == 0; res /= 2) {
+            std::uint32_t blockWidth = 3 * res;
+            std::uint32_t blockHeight = 2 * res;
+            for (auto& shelf : shelves) {
+                if (shelf.height >= blockHeight && shelf.used + blockWidth <= width) {
+                    newTiles.offset = glm::uvec2(shelf.used, shelf.y);
+                    newTiles.resolution = res;
+                    shelf.used += blockWidth;
+                    break;
+                }
+            }
+            if (newTiles.resolution == 0 && top + blockHeight <= height && blockWidth <= width) {
+                shelves.push_back({ top, blockHeight, blockWidth });
+                newTiles.offset = glm::uvec2(0, top);
+                newTiles.resolution = res;
+                top += blockHeight;
+            }
+        }
+        allFit = allFit && newTiles.resolution != 0;
+    }
+    return allFit;
+}
+
+std::vector<ShadowFace> ShadowAtlas::Update(
+    const std::vector<glm::vec3>& positions_,
+    const std::vector<float>& radii_,
+    const Frustum& cameraFrustum,
+    const glm::vec3& cameraPosition,
+    float fovY,
+    std::uint32_t screenHeight,
+    const std::vector<glm::vec4>& dynamicCasters,
+    std::uint32_t budget)
+{
+    std::vector<ShadowFace> faces;
+    numRendered = 0;
+    if (!isLoaded) {
+        return faces;
+    }
+    positions = positions_;
+    radii = radii_;
+
+    //face resolution about the size of light sphere on screen
+    std::vector<std::uint32_t> resolutions(tiles.size());
+    std::vector<bool> visible(tiles.size());
+    bool changed = false;
+    for (std::uint32_t i = 0; i < tiles.size(); ++i) {
+        visible[i] = cameraFrustum.IntersectsSphere(positions[i], radii[i]);
+        float dist = glm::length(positions[i] - cameraPosition);
+        float pixels = dist <= radii[i]
+            ? static_cast<float>(maxResolution)
+            : radii[i] / (dist * std::tan(fovY / 2.0f)) * screenHeight;
+        pixels = std::min(std::max(pixels, static_cast<float>(minResolution)), static_cast<float>(maxResolution));
+        resolutions[i] = tiles[i].requested;
+        if (tiles[i].requested == 0 || std::abs(std::log2(pixels) - std::log2(static_cast<float>(tiles[i].requested))) > kResolutionHysteresis) {
+            resolutions[i] = floorPow2(pixels);
+        }
+        changed = changed || resolutions[i] != tiles[i].requested;
+    }
+    if (changed) {
+        //make all lights smaller until every one gets a shadow
+        std::vector<LightTiles> newTiles;
+        std::vector<std::uint32_t> packed = resolutions;
+        while (!pack(packed, newTiles)) {
+            bool reduced = false;
+            for (auto& res : packed) {
+                if (res > minResolution) {
+                    res /= 2;
+                    reduced = true;
+                }
+            }
+            if (!reduced) {
+                break;
+            }
+        }
+        for (std::uint32_t i = 0; i < tiles.size(); ++i) {
+            //requested resolution is kept, so lights reduced to fit don't repack every frame
+            newTiles[i].requested = resolutions[i];
+            //faces of moved tiles have to be rendered again
+            if (newTiles[i].resolution == tiles[i].resolution && newTiles[i].offset == tiles[i].offset) {
+                newTiles[i].validFaces = tiles[i].validFaces;
+            }
+        }
+        tiles = newTiles;
+    }
+
+    auto schedule = [&](std::uint32_t light, std::uint32_t face) {
+        if (faces.size() >= budget) {
+            return;
+        }
+        for (const auto& scheduled : faces) {
+            if (scheduled.light == light && scheduled.face == face) {
+                return;
+            }
+        }
+        faces.push_back({ light, face });
+    };
+    //faces without valid shadow
+    for (std::uint32_t i = 0; i < tiles.size(); ++i) {
+        if (!visible[i] || tiles[i].resolution == 0) {
+            continue;
+        }
+        for (std::uint32_t face = 0; face < 6; ++face) {
+            if (!(tiles[i].validFaces & (1u << face))) {
+                schedule(i, face);
+            }
+        }
+    }
+    //faces that see moving casters
+    for (std::uint32_t i = 0; i < tiles.size(); ++i) {
+        if (!visible[i] || tiles[i].resolution == 0) {
+            continue;
+        }
+        for (const auto& caster : dynamicCasters) {
+            if (glm::length(glm::vec3(caster) - positions[i]) > radii[i] + caster.w) {
+                continue;
+            }
+            for (std::uint32_t face = 0; face < 6; ++face) {
+                if (Frustum(GetFaceMatrix({ i, face })).IntersectsSphere(glm::vec3(caster), caster.w)) {
+                    schedule(i, face);
+                }
+            }
+        }
+    }
+    //refresh the rest with remaining budget
+    std::uint32_t numFaces = 6 * tiles.size();
+    for (std::uint32_t step = 0; step < numFaces && faces.size() < budget; ++step) {
+        std::uint32_t light = roundRobin / 6;
+        std::uint32_t face = roundRobin % 6;
+        roundRobin = (roundRobin + 1) % numFaces;
+        if (visible[light] && tiles[light].resolution != 0) {
+            schedule(light, face);
+        }
+    }
+
+    for (const auto& face : faces) {
+        tiles[face.light].validFaces |= 1u << face.face;
+    }
+    numRendered = faces.size();
+    return faces;
+}
+
+glm::mat4 ShadowAtlas::GetFaceMatrix(const ShadowFace& face) const
+{
+    const glm::vec3& position = positions[face.light];
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, radii[face.light]);
+    return projection * glm::lookAt(position, position + kFaceForward[face.face], kFaceUp[face.face]);
+}
+
+void ShadowAtlas::BeginFace(const ShadowFace& face)
+{
+    const LightTiles& lightTiles = tiles[face.light];
+    glm::uvec2 offset = lightTiles.offset + glm::uvec2(face.face % 3, face.face / 3) * lightTiles.resolution;
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(offset.x, offset.y, lightTiles.resolution, lightTiles.resolution);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(offset.x, offset.y, lightTiles.resolution, lightTiles.resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    GL_CHECK_ERRORS;
+}
+
+void ShadowAtlas::End()
+{
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void ShadowAtlas::Bind(ShaderProgram& program, int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, isLoaded ? depthTexture : 0);
+    GL_CHECK_ERRORS;
+    program.SetUniform("pointShadowAtlas", unit);
+    for (std::size_t i = 0; i < tiles.size(); ++i) {
+        //offset and face size along x and y in texture coordinates (atlas is 3/2 times wider than high)
+        glm::vec4 rect(
+            static_cast<float>(tiles[i].offset.x) / width,
+            static_cast<float>(tiles[i].offset.y) / height,
+            static_cast<float>(tiles[i].resolution) / width,
+            static_cast<float>(tiles[i].resolution) / height);
+        std::string light = "pointLights[" + std::to_string(i) + "]";
+        program.SetUniform(light + ".atlasRect", rect);
+        program.SetUniform(light + ".atlasFaces", static_cast<int>(tiles[i].resolution == 0 ? 0 : tiles[i].validFaces));
+    }
+}
@@ -0,0 +1,197 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+
+namespace {
+
+//blend of logarithmic and uniform split schemes
+const float kSplitLambda = 0.8f;
+
+//cascade is rendered every period frames, with offset to spread cascades between frames
+int updatePeriod(int cascade)
+{
+    return cascade == 0 ? 1 : (cascade == 1 ? 2 : 4);
+}
+
+int updateOffset(int cascade)
+{
+    return cascade == 1 ? 1 : (cascade == 3 ? 2 : 0);
+}
+
+}
+
+const int ShadowCascades::maxCascades;
+
+void ShadowCascades::Setup(int numCascades_, std::uint32_t resolution_)
+{
+    if (isLoaded) {
+        Release();
+    }
+    numCascades = std::min(std::max(numCascades_, 1), maxCascades);
+    resolution = resolution_;
+    splits = std::vector<float>(numCascades, 0.0f);
+    matrices = std::vector<glm::mat4>(numCascades, glm::mat4(1.0f));
+    biases = std::vector<float>(numCascades, 0.0f);
+    frameIndex = 0;
+
+    glGenTextures(1, &depthTexture);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    GL_CHECK_ERRORS;
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, numCascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    GL_CHECK_ERRORS;
+    //hardware PCF, everything outside of cascade is lit
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    static const float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    GL_CHECK_ERRORS;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GL_CHECK_ERRORS;
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    GL_CHECK_ERRORS;
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Couldn't create framebuffer");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    isLoaded = true;
+}
+
+void ShadowCascades::Release()
+{
+    if (!isLoaded) {
+        return;
+    }
+    glDeleteTextures(1, &depthTexture);
+    GL_CHECK_ERRORS;
+    glDeleteFramebuffers(1, &FBO);
+    GL_CHECK_ERRORS;
+    numCascades = 0;
+    isLoaded = false;
+}
+
+std::vector<int> ShadowCascades::Update(
+    const glm::mat4& view,
+    float fovY,
+    float aspect,
+    float near,
+    float shadowDistance,
+    const glm::vec3& lightDir,
+    const glm::vec3& sceneMin,
+    const glm::vec3& sceneMax)
+{
+    std::vector<int> toRender;
+    if (!isLoaded) {
+        return toRender;
+    }
+
+    //light view doesn't depend on camera, so snapping in light space is stable
+    glm::vec3 up = std::abs(lightDir.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+    //nearest caster along light direction
+    float casterDepth = std::numeric_limits<float>::max();
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner(
+            i & 1 ? sceneMax.x : sceneMin.x,
+            i & 2 ? sceneMax.y : sceneMin.y,
+            i & 4 ? sceneMax.z : sceneMin.z);
+        casterDepth = std::min(casterDepth, -glm::vec3(lightView * glm::vec4(corner, 1.0f)).z);
+    }
+
+    glm::mat4 invView = glm::inverse(view);
+    float tanY = std::tan(fovY / 2.0f);
+    float tanX = tanY * aspect;
+    float sliceNear = near;
+    for (int c = 0; c < numCascades; ++c) {
+        //practical split scheme
+        float t = static_cast<float>(c + 1) / numCascades;
+        float logSplit = near * std::pow(shadowDistance / near, t);
+        float uniformSplit = near + (shadowDistance - near) * t;
+        float sliceFar = kSplitLambda * logSplit + (1.0f - kSplitLambda) * uniformSplit;
+        splits[c] = sliceFar;
+
+        //bounding sphere of slice, its size doesn't change when camera rotates
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 8; ++i) {
+            float depth = i & 4 ? sliceFar : sliceNear;
+            glm::vec3 viewCorner(
+                (i & 1 ? 1.0f : -1.0f) * tanX * depth,
+                (i & 2 ? 1.0f : -1.0f) * tanY * depth,
+                -depth);
+            corners[i] = glm::vec3(invView * glm::vec4(viewCorner, 1.0f));
+            center += corners[i] / 8.0f;
+        }
+        float radius = 0.0f;
+        for (const auto& corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        //cascades rendered less often have to cover camera movement between updates
+        radius *= 1.0f + 0.05f * (updatePeriod(c) - 1);
+        sliceNear = sliceFar;
+
+        if ((frameIndex + updateOffset(c)) % updatePeriod(c) != 0) {
+            continue;
+        }
+
+        //snap center to texels, so shadow edges don't shimmer when camera moves
+        float texelSize = 2.0f * radius / resolution;
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+        lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+        lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+        float zNear = std::min(casterDepth, -lightCenter.z - radius);
+        float zFar = -lightCenter.z + radius;
+        glm::mat4 projection = glm::ortho(
+            lightCenter.x - radius,
+            lightCenter.x + radius,
+            lightCenter.y - radius,
+            lightCenter.y + radius,
+            zNear,
+            zFar);
+        matrices[c] = projection * lightView;
+        //bias of about one and a half texels in [0, 1] depth
+        biases[c] = 1.5f * texelSize / (zFar - zNear);
+        toRender.push_back(c);
+    }
+    ++frameIndex;
+    return toRender;
+}
+
+void ShadowCascades::BeginCascade(int cascade)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+    GL_CHECK_ERRORS;
+    glViewport(0, 0, resolution, resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowCascades::Bind(ShaderProgram& program, int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, isLoaded ? depthTexture : 0);
+    GL_CHECK_ERRORS;
+    program.SetUniform("cascadeShadowMap", unit);
+    program.SetUniform("numCascades", numCascades);
+    glm::vec4 splitsVec(0.0f);
+    glm::vec4 biasesVec(0.0f);
+    for (int c = 0; c < numCascades; ++c) {
+        program.SetUniform("cascadeMatrices[" + std::to_string(c) + "]", matrices[c]);
+        splitsVec[c] = splits[c];
+        biasesVec[c] = biases[c];
+    }
+    program.SetUniform("cascadeSplits", splitsVec);
+    program.SetUniform("cascadeBias", biasesVec);
+}
@@ -1,4 +1,5 @@
 #include "Simulation/Cloth.h"
+#include "CpuProfiler.h"
 
 void Cloth::createMassesAndSprings()
 {
@@ -215,6 +216,7 @@ void Cloth::recomputePositionsNormals(glm::dvec3 offset, bool side)
 
 void Cloth::recomputePositionsNormals()
 {
+    PROFILE_SCOPE("Cloth::recomputePositionsNormals");
     recomputePositionsNormals(glm::dvec3(0.0), true);
     recomputePositionsNormals(glm::dvec3(0.2, 0.0, 0.0), false);
 }
@@ -224,6 +226,7 @@ void Cloth::simulate(
     std::uint32_t simulationSteps,
     std::vector<glm::dvec3> accelerations)
 {
+    PROFILE_SCOPE("Cloth::simulate");
     double mass = density * width * height / widthPoints / heightPoints;
     dt /= simulationSteps;
 
@@ -1,17 +1,51 @@
 #include "App.h"
+#include <cstring>
+
+namespace {
+void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [config.json] [--no-vsync] [--fps N] [--frames N] [--headless] [--dump DIR] [--play PATH]" << std::endl
+              << "  --no-vsync  don't wait for display refresh" << std::endl
+              << "  --fps N     limit frame rate to N frames per second" << std::endl
+              << "  --frames N  render N frames, print frame time statistics and exit" << std::endl
+              << "  --headless  render to offscreen target in hidden window (needs --frames)" << std::endl
+              << "  --dump DIR  write rendered frames to DIR as PNG" << std::endl
+              << "  --play PATH fly camera along recorded path and write timings of every frame" << std::endl;
+}
+}
 
 int main(int argc, char** argv)
 {
-    std::string pathToConfig;
-    switch (argc) {
-    case 1:
-        pathToConfig = std::string("../config.json");
-        break;
-    default:
-        pathToConfig = std::string(argv[1]);
-        break;
+    std::string pathToConfig("../config.json");
+    //command line options override values from config
+    nlohmann::json overrides = nlohmann::json::object();
+    for (int i = 1; i < argc; ++i) {
+        try {
+            if (std::strcmp(argv[i], "--no-vsync") == 0) {
+                overrides["vsync"] = false;
+            } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+                overrides["targetFPS"] = std::stof(argv[++i]);
+            } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                overrides["benchmarkFrames"] = std::stoul(argv[++i]);
+            } else if (std::strcmp(argv[i], "--headless") == 0) {
+                overrides["headless"] = true;
+            } else if (std::strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+                overrides["dumpFrames"] = std::string(argv[++i]);
+            } else if (std::strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+                overrides["cameraPath"] = std::string(argv[++i]);
+                overrides["cameraPlayback"] = true;
+            } else if (argv[i][0] != '-') {
+                pathToConfig = std::string(argv[i]);
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::logic_error&) {
+            printUsage(argv[0]);
+            return 1;
+        }
     }
-    App app(pathToConfig);
+    App app(pathToConfig, overrides);
     int result = app.Run();
     return result;
 }